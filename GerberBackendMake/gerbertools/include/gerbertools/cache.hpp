@@ -0,0 +1,212 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a thread-safe, memory-bounded LRU cache.
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace gerbertools {
+
+/**
+ * Contains a thread-safe, memory-bounded LRU cache.
+ */
+namespace cache {
+
+/**
+ * Statistics for a cache.
+ */
+struct CacheStats {
+
+    /**
+     * Number of lookups that found an entry.
+     */
+    size_t hits;
+
+    /**
+     * Number of lookups that did not find an entry.
+     */
+    size_t misses;
+
+    /**
+     * Number of entries evicted to stay within the memory budget.
+     */
+    size_t evictions;
+
+    /**
+     * Number of entries currently in the cache.
+     */
+    size_t entries;
+
+    /**
+     * Total cost of the entries currently in the cache, in bytes.
+     */
+    size_t size;
+
+    /**
+     * The memory budget of the cache, in bytes.
+     */
+    size_t budget;
+
+};
+
+/**
+ * A cache mapping keys to values under a memory budget. Every entry has a cost
+ * in bytes, supplied by the caller; when the total cost exceeds the budget, the
+ * least recently used entries are evicted. Values are returned by copy, so they
+ * should be cheap to copy, for example a std::shared_ptr to immutable data.
+ * All operations are thread-safe.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LruCache {
+private:
+
+    /**
+     * A cached value along with its key and cost.
+     */
+    struct Entry {
+        K key;
+        V value;
+        size_t cost;
+    };
+
+    /**
+     * Mutex protecting everything below.
+     */
+    mutable std::mutex mutex;
+
+    /**
+     * Entries ordered from most to least recently used.
+     */
+    std::list<Entry> entries;
+
+    /**
+     * Index from key into the entry list.
+     */
+    std::unordered_map<K, typename std::list<Entry>::iterator, Hash> index;
+
+    /**
+     * Hit/miss counters, current size, and budget.
+     */
+    CacheStats stats;
+
+    /**
+     * Evicts least recently used entries until the cache fits the budget.
+     * The mutex must be held.
+     */
+    void evict() {
+        while (stats.size > stats.budget && !entries.empty()) {
+            auto &entry = entries.back();
+            stats.size -= entry.cost;
+            index.erase(entry.key);
+            entries.pop_back();
+            stats.evictions++;
+        }
+        stats.entries = entries.size();
+    }
+
+public:
+
+    /**
+     * Constructs a cache with the given memory budget in bytes.
+     */
+    explicit LruCache(size_t budget) : stats{0, 0, 0, 0, 0, budget} {
+    }
+
+    /**
+     * Returns the value for the given key and marks it as most recently used,
+     * or returns nothing if there is no such entry.
+     */
+    std::optional<V> get(const K &key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            stats.misses++;
+            return std::nullopt;
+        }
+        stats.hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->value;
+    }
+
+    /**
+     * Stores a value with the given cost in bytes, replacing any existing
+     * entry for the key. Values that exceed the budget by themselves are not
+     * stored.
+     */
+    void put(const K &key, V value, size_t cost) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            stats.size -= it->second->cost;
+            entries.erase(it->second);
+            index.erase(it);
+        }
+        if (cost <= stats.budget) {
+            entries.push_front(Entry{key, std::move(value), cost});
+            index.emplace(key, entries.begin());
+            stats.size += cost;
+        }
+        evict();
+    }
+
+    /**
+     * Changes the memory budget, evicting entries as needed.
+     */
+    void set_budget(size_t budget) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.budget = budget;
+        evict();
+    }
+
+    /**
+     * Removes all entries. The counters are left as they are.
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        stats.size = 0;
+        stats.entries = 0;
+    }
+
+    /**
+     * Returns the current statistics.
+     */
+    CacheStats get_stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+};
+
+} // namespace cache
+} // namespace gerbertools
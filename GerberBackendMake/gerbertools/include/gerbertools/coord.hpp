@@ -29,6 +29,7 @@
 #pragma once
 
 #include <string>
+#include <memory>
 #include "clipper.hpp"
 
 namespace gerbertools {
@@ -60,6 +61,17 @@ using Path = ClipperLib::Path;
  */
 using Paths = ClipperLib::Paths;
 
+/**
+ * Shared reference to an immutable set of paths. Derived geometry is passed
+ * around this way, such that layers can share it rather than copy it.
+ */
+using PathsRef = std::shared_ptr<const Paths>;
+
+/**
+ * Moves the given paths into a new shared, immutable buffer.
+ */
+PathsRef share(Paths &&paths);
+
 /**
  * Coordinate format handling. This class converts between Gerber fixed-point
  * and floating point format coordinates, an internal high-accuracy integer
@@ -31,6 +31,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include "coord.hpp"
 #include "plot.hpp"
 #include "aperture.hpp"
@@ -90,6 +91,49 @@ enum class QuadrantMode {
     MULTI
 };
 
+/**
+ * X2 attribute dictionary, mapping attribute names (including the leading
+ * period for standard attributes) to their comma-separated values.
+ */
+using Attributes = std::map<std::string, std::vector<std::string>>;
+
+/**
+ * A flash or draw that was tagged with a net name via the X2 .N object
+ * attribute.
+ */
+struct NetObject {
+
+    /**
+     * Name of the net the object belongs to.
+     */
+    std::string net;
+
+    /**
+     * Reference designator of the component from the .P object attribute, or
+     * empty if the object is not tagged as a component pin.
+     */
+    std::string reference;
+
+    /**
+     * Pin number from the .P object attribute, or empty if the object is not
+     * tagged as a component pin.
+     */
+    std::string pin;
+
+    /**
+     * A point covered by the object: the position for flashes if the aperture
+     * covers it and otherwise some other point of the flash, and the end point
+     * for draws.
+     */
+    coord::CPt coordinate;
+
+    /**
+     * Whether the object is a flash (usually a pad) rather than a draw.
+     */
+    bool flash;
+
+};
+
 /**
  * Main class for parsing Gerber files. The input is parsed during construction
  * of the object.
@@ -213,6 +257,28 @@ private:
      */
     bool outline_constructed;
 
+    /**
+     * File attributes, set via TF commands.
+     */
+    Attributes file_attributes;
+
+    /**
+     * Aperture attributes, set via TA commands and deleted via TD commands.
+     */
+    Attributes aperture_attributes;
+
+    /**
+     * Object attributes, set via TO commands and deleted via TD commands.
+     * These apply to all graphics objects created while they are set.
+     */
+    Attributes object_attributes;
+
+    /**
+     * The flashes and draws on the topmost plot that were tagged with a net
+     * name, in file order.
+     */
+    std::vector<NetObject> net_objects;
+
     /**
      * Render the current aperture to the current plot, taking into
      * consideration all configured aperture transformations.
@@ -233,9 +299,21 @@ private:
     void commit_region();
 
     /**
-     * Handles a Gerber command. Returns true to continue, false if the command
-     * marks the end, or throws a runtime error if the command is not
-     * recognized.
+     * Records an object drawn at the given coordinate in net_objects, if it is
+     * dark, drawn onto the topmost plot, and tagged with a net name. For
+     * flashes, the coordinate is the flash position, but a point that the
+     * current aperture actually covers is recorded.
+     */
+    void record_net_object(coord::CPt coordinate, bool flash);
+
+    /**
+     * Handles an X2 attribute command (TF, TA, TO, or TD).
+     */
+    void set_attribute(const std::string &cmd);
+
+    /**
+     * Handles a Gerber command. Returns true to continue, or false if the
+     * command marks the end. Commands that are not recognized are ignored.
      */
     bool command(const std::string &cmd, bool is_attrib);
 
@@ -267,6 +345,19 @@ public:
      */
     const coord::Paths &get_outline_paths();
 
+    /**
+     * Returns the file attributes set via TF commands.
+     */
+    const Attributes &get_file_attributes() const;
+
+    /**
+     * Returns the flashes and draws that were tagged with a net name via the
+     * X2 .N object attribute, in file order. Regions, objects with clear
+     * polarity and objects inside block apertures are not included, and
+     * objects on more than one net are listed once for each net.
+     */
+    const std::vector<NetObject> &get_net_objects() const;
+
 };
 
 } // namespace gerber
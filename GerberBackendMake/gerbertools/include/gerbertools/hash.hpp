@@ -0,0 +1,116 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a fast, non-cryptographic content hash (XXH64), used to key caches
+ * on file contents and as an ETag for rendered outputs.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+
+namespace gerbertools {
+
+/**
+ * Contains a fast, non-cryptographic content hash.
+ */
+namespace hash {
+
+/**
+ * Computes the XXH64 hash of the given data with the given seed.
+ */
+uint64_t xxh64(const void *data, size_t size, uint64_t seed = 0);
+
+/**
+ * Computes the XXH64 hash of the given string with the given seed.
+ */
+uint64_t xxh64(std::string_view data, uint64_t seed = 0);
+
+/**
+ * Incrementally hashes a sequence of values. Every value is hashed with the
+ * hash of everything before it as seed, so the boundaries between values
+ * affect the result.
+ */
+class Hasher {
+private:
+
+    /**
+     * The hash of everything added so far.
+     */
+    uint64_t state;
+
+public:
+
+    /**
+     * Constructs a hasher with the given seed.
+     */
+    explicit Hasher(uint64_t seed = 0);
+
+    /**
+     * Adds the given string to the hash.
+     */
+    Hasher &add(std::string_view data);
+
+    /**
+     * Adds the given integer to the hash.
+     */
+    Hasher &add(uint64_t value);
+
+    /**
+     * Adds the given floating point value to the hash.
+     */
+    Hasher &add(double value);
+
+    /**
+     * Returns the hash of everything added so far.
+     */
+    uint64_t digest() const;
+
+};
+
+/**
+ * Hashes a map of file contents by role, as passed to
+ * pcb::CircuitBoard::LoadPCB().
+ */
+uint64_t hash_files(const std::map<std::string, std::vector<std::string>> &files);
+
+/**
+ * As above, for file contents held as views. Gives the same hash as the
+ * equivalent map of strings.
+ */
+uint64_t hash_files(const std::map<std::string, std::vector<std::string_view>> &files);
+
+/**
+ * Formats a hash as 16 lowercase hexadecimal digits, suitable for use as an
+ * ETag.
+ */
+std::string to_hex(uint64_t hash);
+
+} // namespace hash
+} // namespace gerbertools
@@ -0,0 +1,102 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a streaming reader for IPC-D-356 netlists.
+ */
+
+#pragma once
+
+#include <string>
+#include <istream>
+#include <functional>
+#include "coord.hpp"
+#include "netlist.hpp"
+
+namespace gerbertools {
+
+/**
+ * Namespace for reading IPC-D-356 netlists, as used for bare-board electrical
+ * testing and for comparing a PCB against the netlist of the design tool.
+ */
+namespace ipc356 {
+
+/**
+ * A test point record from an IPC-D-356 netlist.
+ */
+struct TestPoint {
+
+    /**
+     * Name of the net, with NNAME aliases for long names resolved.
+     */
+    std::string net;
+
+    /**
+     * Reference designator of the component, or VIA for vias.
+     */
+    std::string reference;
+
+    /**
+     * Pin of the component.
+     */
+    std::string pin;
+
+    /**
+     * Location of the test point.
+     */
+    coord::CPt coordinate;
+
+    /**
+     * Layer index of the test point, from -N to -1 for bottom to top. Access
+     * codes A00 and A01 map to the top layer, and any other code to the layer
+     * with that number counted from the top.
+     */
+    int layer;
+
+    /**
+     * Whether this is a through-hole (317) rather than a surface mount (327)
+     * test point.
+     */
+    bool through_hole;
+
+};
+
+/**
+ * Reads the test point records of an IPC-D-356 netlist from the given stream
+ * one by one, calling fn for each. The file is processed line by line and
+ * never held in memory as a whole. Test points that are not connected to any
+ * net (N/C) and unplated holes (U in column 38) are skipped.
+ */
+void read(std::istream &stream, const std::function<void(const TestPoint&)> &fn);
+
+/**
+ * Reads the test points of an IPC-D-356 netlist from the given stream and adds
+ * them to the given builder as connection points. The points are passed to
+ * NetlistBuilder::add_connections() in batches of the given size, such that
+ * only one batch is buffered at a time. Returns the number of points added.
+ */
+size_t read_connections(std::istream &stream, netlist::NetlistBuilder &builder, size_t batch_size = 4096);
+
+} // namespace ipc356
+} // namespace gerbertools
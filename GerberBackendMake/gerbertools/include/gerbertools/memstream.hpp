@@ -0,0 +1,122 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains an input stream that reads directly from a caller-owned buffer.
+ */
+
+#pragma once
+
+#include <istream>
+#include <streambuf>
+#include <string_view>
+
+namespace gerbertools {
+
+/**
+ * Contains an input stream that reads directly from a caller-owned buffer,
+ * such that file contents can be parsed without copying them first.
+ */
+namespace memstream {
+
+/**
+ * Read-only stream buffer over a block of memory. The memory is not copied
+ * and must outlive the buffer.
+ */
+class ViewBuf : public std::streambuf {
+protected:
+
+    /**
+     * Repositions the read pointer relative to the start, current position,
+     * or end of the buffer.
+     */
+    pos_type seekoff(
+        off_type off,
+        std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::in
+    ) override {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        char *base = eback();
+        if (dir == std::ios_base::cur) {
+            off += gptr() - base;
+        } else if (dir == std::ios_base::end) {
+            off += egptr() - base;
+        }
+        if (off < 0 || off > egptr() - base) {
+            return pos_type(off_type(-1));
+        }
+        setg(base, base + off, egptr());
+        return pos_type(off);
+    }
+
+    /**
+     * Repositions the read pointer to an absolute position.
+     */
+    pos_type seekpos(
+        pos_type pos,
+        std::ios_base::openmode which = std::ios_base::in
+    ) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+public:
+
+    /**
+     * Constructs a stream buffer that reads the given data. The buffer is
+     * never written to.
+     */
+    explicit ViewBuf(std::string_view data) {
+        auto begin = const_cast<char*>(data.data());
+        setg(begin, begin, begin + data.size());
+    }
+
+};
+
+/**
+ * Input stream over a block of memory. The memory is not copied and must
+ * outlive the stream.
+ */
+class ViewStream : public std::istream {
+private:
+
+    /**
+     * The underlying stream buffer.
+     */
+    ViewBuf buf;
+
+public:
+
+    /**
+     * Constructs a stream that reads the given data.
+     */
+    explicit ViewStream(std::string_view data) : std::istream(nullptr), buf(data) {
+        rdbuf(&buf);
+    }
+
+};
+
+} // namespace memstream
+} // namespace gerbertools
@@ -31,10 +31,11 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <list>
+#include <vector>
 #include <fstream>
 #include "clipper.hpp"
 #include "coord.hpp"
-#include "plot.hpp"
 
 namespace gerbertools {
 
@@ -155,7 +156,7 @@ public:
      * Returns the path that the drill took to make the via. For most vias this
      * will be a single point, but plated slots are possible this way.
      */
-    coord::Path get_path() const;
+    const coord::Path &get_path() const;
 
     /**
      * Returns the size of the finished hole.
@@ -164,6 +165,90 @@ public:
 
 };
 
+/**
+ * Represents a hole as a geometric primitive rather than as a polygon. Every
+ * drill hit becomes a round hole with start equal to end; routed slots are
+ * decomposed into straight segments swept by the tool, each of which becomes a
+ * hole with a distinct end point. Arcs are already approximated by segments at
+ * this point.
+ */
+class Hole {
+private:
+
+    /**
+     * Center of the hole, or the start of the slot segment.
+     */
+    coord::CPt start;
+
+    /**
+     * End of the slot segment. Equal to start for round holes.
+     */
+    coord::CPt end;
+
+    /**
+     * Diameter of the tool that made the hole.
+     */
+    coord::CInt diameter;
+
+    /**
+     * Whether the hole is plated.
+     */
+    bool plated;
+
+public:
+
+    /**
+     * Constructs a new hole.
+     */
+    Hole(coord::CPt start, coord::CPt end, coord::CInt diameter, bool plated);
+
+    /**
+     * Returns the center of the hole, or the start of the slot segment.
+     */
+    coord::CPt get_start() const;
+
+    /**
+     * Returns the end of the slot segment. Equal to get_start() for round
+     * holes.
+     */
+    coord::CPt get_end() const;
+
+    /**
+     * Returns the diameter of the tool that made the hole.
+     */
+    coord::CInt get_diameter() const;
+
+    /**
+     * Returns whether the hole is plated.
+     */
+    bool is_plated() const;
+
+    /**
+     * Returns whether this is a slot segment rather than a round hole.
+     */
+    bool is_slot() const;
+
+};
+
+/**
+ * Flat table of hole primitives.
+ */
+using HoleTable = std::vector<Hole>;
+
+/**
+ * Polygonizes the selected holes in the given table, optionally expanding
+ * their diameter by twice the given amount. The result is the positively-wound
+ * union of all the holes. Holes of the same (expanded) diameter are offset in a
+ * single pass, using the arc tolerance and miter limit of the given format.
+ */
+coord::Paths render_holes(
+    const HoleTable &holes,
+    bool plated=true,
+    bool unplated=true,
+    coord::CInt expansion=0,
+    const coord::Format &fmt=coord::Format()
+);
+
 /**
  * Parses NC drill files as generated by Altium Designer and/or complying with
  * the XNC specification by Ucamco.
@@ -213,14 +298,9 @@ private:
     coord::Path path;
 
     /**
-     * Plot for plated holes.
+     * All holes drilled or routed thus far, as primitives.
      */
-    plot::Plot plot_pth;
-
-    /**
-     * Plot for non-plated holes.
-     */
-    plot::Plot plot_npth;
+    HoleTable holes;
 
     /**
      * Points where a plated tool have been.
@@ -228,8 +308,8 @@ private:
     std::list<Via> vias;
 
     /**
-     * Commits the path in the path field to the plots and to vias based on the
-     * current tool.
+     * Commits the path in the path field to the hole table and to vias based
+     * on the current tool.
      */
     void commit_path();
 
@@ -259,10 +339,15 @@ public:
 
     /**
      * Returns the cutout paths for this NC drill file as negatively-wound
-     * polygons.
+     * polygons. These are rendered from the hole table on every call.
      */
     coord::Paths get_paths(bool plated=true, bool unplated=true) const;
 
+    /**
+     * Returns all holes in this NC drill file as primitives.
+     */
+    const HoleTable &get_holes() const;
+
     /**
      * Returns the center coordinates of all plated holes.
      */
@@ -29,11 +29,15 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <list>
 #include <set>
 #include <map>
+#include <vector>
+#include <unordered_map>
+#include <functional>
 #include "coord.hpp"
 
 namespace gerbertools {
@@ -98,7 +102,7 @@ namespace gerbertools {
 			/**
 			 * Returns the entire milled path for the via.
 			 */
-			coord::Path get_path() const;
+			const coord::Path& get_path() const;
 
 			/**
 			 * Returns the size of the finished hole.
@@ -130,6 +134,120 @@ namespace gerbertools {
 
 		};
 
+		/**
+		 * Maps Y coordinates to the items whose (inclusive) Y range contains them.
+		 * The total range is divided into equally high horizontal slabs, and each
+		 * slab lists the items that overlap it.
+		 */
+		class SlabIndex {
+		private:
+
+			/**
+			 * Lowest Y coordinate covered by the slabs.
+			 */
+			coord::CInt bottom;
+
+			/**
+			 * Highest Y coordinate covered by the slabs.
+			 */
+			coord::CInt top;
+
+			/**
+			 * Height of each slab.
+			 */
+			coord::CInt slab_height;
+
+			/**
+			 * The items of slab i are items[offsets[i]] up to items[offsets[i + 1]].
+			 */
+			std::vector<uint32_t> offsets;
+
+			/**
+			 * Item indices for all slabs, concatenated.
+			 */
+			std::vector<uint32_t> items;
+
+		public:
+
+			/**
+			 * Constructs an empty index.
+			 */
+			SlabIndex();
+
+			/**
+			 * Constructs an index for items with the given Y ranges, using the given
+			 * number of slabs.
+			 */
+			SlabIndex(const std::vector<std::pair<coord::CInt, coord::CInt>>& ranges, size_t num_slabs);
+
+			/**
+			 * Returns the range of item indices that may contain the given Y
+			 * coordinate. All items that do are in the range.
+			 */
+			std::pair<const uint32_t*, const uint32_t*> find(coord::CInt y) const;
+
+		};
+
+		/**
+		 * A line segment between two points.
+		 */
+		using Segment = std::pair<coord::CPt, coord::CPt>;
+
+		/**
+		 * Uniform grid over a set of line segments, for finding the segment
+		 * nearest to a point without visiting all of them. Each cell lists the
+		 * segments whose bounding box overlaps it.
+		 */
+		class SegmentIndex {
+		private:
+
+			/**
+			 * All segments.
+			 */
+			std::vector<Segment> segments;
+
+			/**
+			 * Edge length of the grid cells.
+			 */
+			coord::CInt cell_size;
+
+			/**
+			 * Range of cell indices that contain segments.
+			 */
+			int64_t min_x, min_y, max_x, max_y;
+
+			/**
+			 * Segment indices by cell. Only cells that overlap a segment are stored.
+			 */
+			std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+
+			/**
+			 * Calls fn for the indices of all segments in the given cell.
+			 */
+			template <typename F>
+			void visit_cell(int64_t x, int64_t y, F fn) const;
+
+		public:
+
+			/**
+			 * Constructs an index for the given segments.
+			 */
+			explicit SegmentIndex(std::vector<Segment> segments);
+
+			/**
+			 * Returns the squared distance from the given point to the nearest
+			 * segment, or infinity if there are no segments.
+			 */
+			double nearest_distance_sqr(coord::CPt point) const;
+
+			/**
+			 * Calls fn for every segment that may overlap the given rectangle. A
+			 * segment may be visited more than once.
+			 */
+			void visit(const coord::CRect& rect, const std::function<void(const Segment&)>& fn) const;
+
+		};
+
 		/**
 		 * Represents a copper shape on one of the copper layers of the PCB, not
 		 * connected to any other bits of copper in that layer without involvement of
@@ -154,6 +272,26 @@ namespace gerbertools {
 			 */
 			coord::CRect bounding_box;
 
+			/**
+			 * Edges of the outline by Y slab. Edge i runs from vertex i to the next.
+			 */
+			SlabIndex outline_edges;
+
+			/**
+			 * Bounding boxes of the holes.
+			 */
+			std::vector<coord::CRect> hole_boxes;
+
+			/**
+			 * Holes by Y slab.
+			 */
+			SlabIndex hole_slabs;
+
+			/**
+			 * Edges of each hole by Y slab.
+			 */
+			std::vector<SlabIndex> hole_edges;
+
 			/**
 			 * Layer index for this shape. Layer indices are from 0 to N-1 for bottom
 			 * to top.
@@ -181,6 +319,11 @@ namespace gerbertools {
 			 */
 			const coord::Paths& get_holes() const;
 
+			/**
+			 * Returns the axis-aligned bounding box of the shape.
+			 */
+			const coord::CRect& get_bounding_box() const;
+
 			/**
 			 * Returns the layer index for this shape. Layer indices are from 0 to N-1
 			 * for bottom to top.
@@ -192,19 +335,22 @@ namespace gerbertools {
 			 */
 			bool contains(coord::CPt point) const;
 
+			/**
+			 * Determines for each of the given points whether it is inside the shape.
+			 */
+			std::vector<bool> contains(const std::vector<coord::CPt>& points) const;
+
 		};
 
 		/**
-		 * Compare function for weak pointers by what they point to.
+		 * Compare function for weak pointers by the object they share ownership
+		 * of. This does not need to lock the pointers, and the order does not
+		 * change when the object expires.
 		 */
 		template <typename T>
 		struct WeakPointerCompare {
 			bool operator() (const T& lhs, const T& rhs) const {
-				auto rptr = rhs.lock();
-				if (!rptr) return false;
-				auto lptr = lhs.lock();
-				if (!lptr) return true;
-				return (unsigned long)lptr.get() < (unsigned long)rptr.get();
+				return lhs.owner_before(rhs);
 			}
 		};
 
@@ -214,9 +360,7 @@ namespace gerbertools {
 		template <typename T>
 		struct SharedPointerCompare {
 			bool operator() (const T& lptr, const T& rptr) const {
-				if (!rptr) return false;
-				if (!lptr) return true;
-				return (unsigned long)lptr.get() < (unsigned long)rptr.get();
+				return std::less<typename T::element_type*>()(lptr.get(), rptr.get());
 			}
 		};
 
@@ -225,16 +369,6 @@ namespace gerbertools {
 		class PhysicalNet;
 		class LogicalNet;
 
-		/**
-		 * Reference to a shape object.
-		 */
-		using ShapeRef = std::shared_ptr<Shape>;
-
-		/**
-		 * Reference to a via object.
-		 */
-		using ViaRef = std::shared_ptr<Via>;
-
 		/**
 		 * Reference to a physical net.
 		 */
@@ -260,21 +394,145 @@ namespace gerbertools {
 		 */
 		using LogicalNets = std::set<LogicalNetWeakRef, WeakPointerCompare<LogicalNetWeakRef>>;
 
+		/**
+		 * Index of a shape in a NetArena.
+		 */
+		using ShapeId = uint32_t;
+
+		/**
+		 * Index of a via in a NetArena.
+		 */
+		using ViaId = uint32_t;
+
+		/**
+		 * Index of a physical net in a NetArena.
+		 */
+		using NetId = uint32_t;
+
+		/**
+		 * Marks the absence of a physical net, for example where a point is not
+		 * on copper.
+		 */
+		constexpr NetId NO_NET = UINT32_MAX;
+
+		/**
+		 * Read-only view of a contiguous range of elements.
+		 */
+		template <typename T>
+		class Span {
+		private:
+
+			/**
+			 * Pointers to the first element and one past the last element.
+			 */
+			const T *first, *last;
+
+		public:
+
+			/**
+			 * Constructs a view of the elements from first up to but excluding last.
+			 */
+			Span(const T* first, const T* last) : first(first), last(last) {}
+
+			/**
+			 * Returns a pointer to the first element.
+			 */
+			const T* begin() const { return first; }
+
+			/**
+			 * Returns a pointer one past the last element.
+			 */
+			const T* end() const { return last; }
+
+			/**
+			 * Returns the number of elements.
+			 */
+			size_t size() const { return last - first; }
+
+			/**
+			 * Returns whether there are no elements.
+			 */
+			bool empty() const { return first == last; }
+
+			/**
+			 * Returns the element with the given index.
+			 */
+			const T& operator[](size_t index) const { return first[index]; }
+
+		};
+
+		/**
+		 * Dense storage for the shapes and vias of a finished physical netlist.
+		 * Shapes and vias are stored grouped by net, such that the objects of
+		 * net n have the contiguous id ranges [net_shapes[n], net_shapes[n + 1])
+		 * and [net_vias[n], net_vias[n + 1]). Nets are numbered in the order they
+		 * are listed in by the netlist.
+		 */
+		struct NetArena {
+
+			/**
+			 * All copper shapes, by id.
+			 */
+			std::vector<Shape> shapes;
+
+			/**
+			 * All vias connected to copper, by id.
+			 */
+			std::vector<Via> vias;
+
+			/**
+			 * The net that each shape belongs to, by shape id.
+			 */
+			std::vector<NetId> shape_nets;
+
+			/**
+			 * The net that each via belongs to, by via id.
+			 */
+			std::vector<NetId> via_nets;
+
+			/**
+			 * The first shape id of each net, followed by the number of shapes.
+			 */
+			std::vector<ShapeId> net_shapes;
+
+			/**
+			 * The first via id of each net, followed by the number of vias.
+			 */
+			std::vector<ViaId> net_vias;
+
+			/**
+			 * Returns the number of nets.
+			 */
+			size_t get_net_count() const;
+
+			/**
+			 * Returns the shapes of the given net.
+			 */
+			Span<Shape> get_shapes(NetId net) const;
+
+			/**
+			 * Returns the vias of the given net.
+			 */
+			Span<Via> get_vias(NetId net) const;
+
+		};
+
 		/**
 		 * Represents a physical net, i.e. a set of connected copper shapes and vias
-		 * that are physically connected on the PCB.
+		 * that are physically connected on the PCB. This is a view of a range of
+		 * objects in the NetArena of a physical netlist.
 		 */
 		class PhysicalNet {
 
 			/**
-			 * The copper shapes connected to this net.
+			 * The arena that the shapes and vias of this net are stored in.
 			 */
-			std::list<ShapeRef> shapes;
+			std::shared_ptr<const NetArena> arena;
 
 			/**
-			 * The vias connected to this net.
+			 * The id of this net within the arena.
 			 */
-			std::list<ViaRef> vias;
+			NetId id;
 
 			/**
 			 * Weak references to the logical nets that are associated to this net.
@@ -284,20 +542,14 @@ namespace gerbertools {
 		public:
 
 			/**
-			 * Constructs a physical net from the given initial shape.
-			 */
-			PhysicalNet(const ShapeRef& shape);
-
-			/**
-			 * Adds a via to this net.
+			 * Constructs a view of the net with the given id in the given arena.
 			 */
-			void add_via(const ViaRef& via);
+			PhysicalNet(std::shared_ptr<const NetArena> arena, NetId id);
 
 			/**
-			 * Moves the objects from the given net into this net in order to merge
-			 * them.
+			 * Returns the id of this net within the arena of its netlist.
 			 */
-			void merge_with(const PhysicalNetRef& net);
+			NetId get_id() const;
 
 			/**
 			 * Determines whether the given point on the given layer is part of this
@@ -311,14 +563,14 @@ namespace gerbertools {
 			void assign_logical(const LogicalNetRef& logical_net);
 
 			/**
-			 * Returns the list of copper shapes connected to this net.
+			 * Returns the copper shapes connected to this net.
 			 */
-			const std::list<ShapeRef>& get_shapes() const;
+			Span<Shape> get_shapes() const;
 
 			/**
-			 * Returns the list of vias connected to this net.
+			 * Returns the vias connected to this net.
 			 */
-			const std::list<ViaRef>& get_vias();
+			Span<Via> get_vias() const;
 
 			/**
 			 * Returns the set of logical net names associated with this physical net.
@@ -345,12 +597,6 @@ namespace gerbertools {
 			 */
 			PhysicalNets connected_nets;
 
-			/**
-			 * Weak references to the physical nets that are associated to this net due
-			 * to clearance violations.
-			 */
-			PhysicalNets clearance_nets;
-
 		public:
 
 			/**
@@ -364,9 +610,9 @@ namespace gerbertools {
 			const std::string& get_name() const;
 
 			/**
-			 * Assigns physical nets from both physical netlists to this logical net.
+			 * Assigns a physical net to this logical net.
 			 */
-			void assign_physical(const PhysicalNetRef& connected, const PhysicalNetRef& clearance);
+			void assign_physical(const PhysicalNetRef& connected);
 
 			/**
 			 * Returns the set of physical nets from the connection netlist associated
@@ -374,33 +620,181 @@ namespace gerbertools {
 			 */
 			const PhysicalNets& get_connected_nets() const;
 
-			/**
-			 * Returns the set of physical nets from the clearance netlist associated
-			 * with this logical net.
-			 */
-			const PhysicalNets& get_clearance_nets() const;
-
 		};
 
 		/**
-		 * Represents a complete physical netlist derived from the PCB. Two of these are
-		 * used for electrical DRC: the connection netlist is built from the PCB as-is,
-		 * while the clearance netlist is built from the PCB after expansion of all
-		 * copper shapes by 1/2 the minimum clearance.
+		 * Represents a complete physical netlist derived from the PCB, i.e. the
+		 * pieces of connected copper on the PCB as-is.
 		 */
 		class PhysicalNetlist {
 		private:
 
 			/**
-			 * The list of nets in this netlist.
+			 * Marks the absence of a shape or via index.
 			 */
-			std::list<PhysicalNetRef> nets;
+			static constexpr size_t NONE = SIZE_MAX;
+
+			/**
+			 * Disjoint-set node for a shape. Every set of connected shapes forms a
+			 * net; the fields other than parent, next_shape and next_via are only
+			 * meaningful for the root of a set. Shapes and vias of a set are kept in
+			 * linked lists, such that merging two sets is constant-time.
+			 */
+			struct ShapeSet {
+
+				/**
+				 * Parent in the disjoint-set forest. Roots are their own parent.
+				 */
+				size_t parent;
+
+				/**
+				 * Number of shapes in the set.
+				 */
+				size_t size;
+
+				/**
+				 * The shape that the net was originally created for. Nets are listed
+				 * in the order of their anchor shapes.
+				 */
+				size_t anchor;
+
+				/**
+				 * First and last shape in the set.
+				 */
+				size_t first_shape, last_shape;
+
+				/**
+				 * Next shape in the set that this shape belongs to.
+				 */
+				size_t next_shape;
+
+				/**
+				 * First and last via connected to the set.
+				 */
+				size_t first_via, last_via;
+
+			};
+
+			/**
+			 * The views of the nets in this netlist, by id, allocated as a single
+			 * block. Populated by finish(). Internally, nets are referred to by id;
+			 * references to the views are only handed out by get_net() and
+			 * get_nets().
+			 */
+			std::shared_ptr<std::vector<PhysicalNet>> nets;
+
+			/**
+			 * Dense storage for the shapes and vias, grouped by net. Populated by
+			 * finish(), and shared with the nets.
+			 */
+			std::shared_ptr<const NetArena> arena;
 
 			/**
 			 * Records whether we've started adding vias.
 			 */
 			bool vias_added;
 
+			/**
+			 * Records whether finish() has been called.
+			 */
+			bool finished;
+
+			/**
+			 * All shapes, in the order they were registered. Shapes are referred to
+			 * by their index in this vector until finish() moves them into the
+			 * arena.
+			 */
+			std::vector<Shape> shapes;
+
+			/**
+			 * Disjoint-set nodes, by shape index.
+			 */
+			std::vector<ShapeSet> sets;
+
+			/**
+			 * The via records of all vias connected to copper, and for each of
+			 * those the index of the next via of the same set.
+			 */
+			std::vector<std::pair<size_t, size_t>> vias;
+
+			/**
+			 * Spatial index of the shapes. For each layer, a uniform grid maps each
+			 * cell to the indices of the shapes whose bounding box overlaps it, such
+			 * that a point lookup only needs to test a few shapes. Only cells that
+			 * overlap a shape are stored. finish() renumbers the shapes to their
+			 * ids in the arena.
+			 */
+			std::vector<std::unordered_map<uint64_t, std::vector<ShapeId>>> index;
+
+			/**
+			 * A via passed to register_via(), along with the layers it reaches.
+			 */
+			struct ViaRecord {
+
+				/**
+				 * The via.
+				 */
+				Via via;
+
+				/**
+				 * The lowest and topmost layer that the via reaches.
+				 */
+				size_t lower_layer, upper_layer;
+
+				/**
+				 * Index of the shape hit on the lowest layer in via_hits. The hits on
+				 * the other layers follow it.
+				 */
+				size_t first_hit;
+
+			};
+
+			/**
+			 * All vias passed to register_via(), in order, including those that did
+			 * not connect to copper. These are kept such that the netlist can be
+			 * updated when a layer is replaced.
+			 */
+			std::vector<ViaRecord> via_records;
+
+			/**
+			 * For every via record and every layer it reaches, the shape that the
+			 * via hits there, or NONE if there is no copper. finish() renumbers the
+			 * shapes to their ids in the arena.
+			 */
+			std::vector<size_t> via_hits;
+
+			/**
+			 * The arena ids of the shapes, in the order in which they were
+			 * registered. Populated by finish().
+			 */
+			std::vector<ShapeId> registration_order;
+
+			/**
+			 * Returns the index of the shape at the given point on the given layer,
+			 * or NONE if there is no copper there.
+			 */
+			size_t find_shape(coord::CPt point, size_t layer) const;
+
+			/**
+			 * Merges the shapes hit by the via of the given record and adds the via
+			 * to the resulting set. Returns false if the via misses copper on any
+			 * of its layers.
+			 */
+			bool connect_via(size_t record);
+
+			/**
+			 * Returns the root of the set that the given shape belongs to,
+			 * compressing the path to it along the way.
+			 */
+			size_t find_root(size_t shape);
+
+			/**
+			 * Merges the set of the source shape into the set of the target shape.
+			 * Shapes and vias of the source set are ordered after those of the
+			 * target.
+			 */
+			void merge(size_t target, size_t source);
+
 		public:
 
 			/**
@@ -412,7 +806,7 @@ namespace gerbertools {
 			 * Adds a copper shape to the netlist. The netlist is updated accordingly.
 			 * All shapes must be added before vias are added.
 			 */
-			void register_shape(const ShapeRef& shape);
+			void register_shape(Shape shape);
 
 			/**
 			 * Like register_shape(), but using a set of closed paths for a given copper
@@ -425,18 +819,71 @@ namespace gerbertools {
 			 * true if successful, or false if any of the specified layers do not have
 			 * copper at the center point of the via.
 			 */
-			bool register_via(const ViaRef& via, size_t num_layers);
+			bool register_via(const Via& via, size_t num_layers);
+
+			/**
+			 * Creates the physical nets once all shapes and vias have been
+			 * registered. Nothing can be registered after this, and the nets can only
+			 * be queried after this.
+			 */
+			void finish();
+
+			/**
+			 * Returns the id of the net that the given point belongs to, or NO_NET
+			 * if there is no (virtual) copper at the given point.
+			 */
+			NetId find_net(coord::CPt point, size_t layer) const;
+
+			/**
+			 * Like find_net(), but for many points at once. The points are sorted
+			 * spatially, such that all points that fall in the same cell of the
+			 * spatial index are tested against its shapes together; cells are
+			 * processed in parallel using up to num_threads threads (0 for the
+			 * hardware concurrency). layers must have the same size as points.
+			 */
+			std::vector<NetId> find_nets(
+				const std::vector<coord::CPt>& points,
+				const std::vector<size_t>& layers,
+				size_t num_threads = 0
+			) const;
+
+			/**
+			 * Returns the physical net with the given id.
+			 */
+			PhysicalNetRef get_net(NetId net) const;
+
+			/**
+			 * Returns all physical nets, by id.
+			 */
+			std::vector<PhysicalNetRef> get_nets() const;
+
+			/**
+			 * Returns the logical nets associated with the physical net with the
+			 * given id.
+			 */
+			const LogicalNets& get_logical_nets(NetId net) const;
+
+			/**
+			 * Returns the vias that are not connected to copper on one or more of
+			 * their layers, in the order they were registered.
+			 */
+			std::vector<Via> get_unconnected_vias() const;
 
 			/**
-			 * Returns which net belongs to the given point. The returned pointer will
-			 * be null if there is no (virtual) copper at the given point.
+			 * Returns a finished copy of this netlist in which the copper on the
+			 * given layer is replaced by the given paths. Only the shapes of that
+			 * layer are recomputed and only the vias that reach it are located
+			 * again; the shapes of the other layers and where the vias hit them are
+			 * reused, such that only the cheap merging of the sets is redone. This
+			 * netlist must be finished, and its shapes must have been registered
+			 * layer by layer, bottom-up.
 			 */
-			PhysicalNetRef find_net(coord::CPt point, size_t layer) const;
+			PhysicalNetlist replace_layer(size_t layer, const coord::Paths& paths) const;
 
 			/**
-			 * Returns the list of all physical nets.
+			 * Returns the dense storage for the shapes and vias of the nets.
 			 */
-			const std::list<PhysicalNetRef>& get_nets() const;
+			const NetArena& get_arena() const;
 
 		};
 
@@ -483,7 +930,127 @@ namespace gerbertools {
 			/**
 			 * Returns the logical net for this connection point.
 			 */
-			LogicalNetRef get_net() const;
+			const LogicalNetRef& get_net() const;
+
+		};
+
+		/**
+		 * The kinds of design rule violations that Netlist::check() can report.
+		 */
+		enum class ViolationType {
+
+			/**
+			 * A via is not connected to copper on one or more of its layers.
+			 */
+			UNCONNECTED_VIA,
+
+			/**
+			 * A connection point for a logical net has no copper under it.
+			 */
+			MISSING_COPPER,
+
+			/**
+			 * A logical net is not connected to any copper at all.
+			 */
+			UNROUTED_NET,
+
+			/**
+			 * A logical net is divided up into more than one piece of copper.
+			 */
+			DIVIDED_NET,
+
+			/**
+			 * Two logical nets are connected by copper.
+			 */
+			SHORT_CIRCUIT,
+
+			/**
+			 * Two logical nets are closer to each other than the clearance.
+			 */
+			CLEARANCE,
+
+			/**
+			 * A via has less annular ring than the minimum.
+			 */
+			ANNULAR_RING
+
+		};
+
+		/**
+		 * A single design rule violation. Which fields are meaningful depends on
+		 * the type; the others are left zero or empty.
+		 */
+		struct Violation {
+
+			/**
+			 * The kind of violation.
+			 */
+			ViolationType type;
+
+			/**
+			 * Location of the violating via or connection point.
+			 */
+			coord::CPt coordinate;
+
+			/**
+			 * Layer index of the connection point, for MISSING_COPPER.
+			 */
+			size_t layer;
+
+			/**
+			 * The logical net involved, or the first of the two nets for
+			 * SHORT_CIRCUIT and CLEARANCE.
+			 */
+			std::string net;
+
+			/**
+			 * The second logical net for SHORT_CIRCUIT and CLEARANCE.
+			 */
+			std::string other_net;
+
+			/**
+			 * The number of islands for DIVIDED_NET.
+			 */
+			size_t islands;
+
+			/**
+			 * The measured annular ring for ANNULAR_RING.
+			 */
+			double annular_ring;
+
+			/**
+			 * The minimum annular ring that was checked against for ANNULAR_RING.
+			 */
+			coord::CInt minimum;
+
+			/**
+			 * Formats the violation as a human-readable message.
+			 */
+			std::string to_string() const;
+
+		};
+
+		/**
+		 * A connection point in bulk form, for NetlistBuilder::add_connections().
+		 */
+		struct ConnectionRecord {
+
+			/**
+			 * The coordinate for the connection point.
+			 */
+			coord::CPt coordinate;
+
+			/**
+			 * Layer index for the connection point. Layer indices are from 0 to N-1 or
+			 * from -N to -1 for bottom to top.
+			 */
+			int layer;
+
+			/**
+			 * Index of the logical net in the list of net names passed along with
+			 * the record.
+			 */
+			uint32_t net;
 
 		};
 
@@ -506,7 +1073,7 @@ namespace gerbertools {
 			/**
 			 * The vias connecting the layers together.
 			 */
-			std::list<ViaRef> vias;
+			std::list<Via> vias;
 
 			/**
 			 * Mapping from net names to logical nets.
@@ -516,7 +1083,13 @@ namespace gerbertools {
 			/**
 			 * All the connection points.
 			 */
-			std::list<ConnectionPoint> connections;
+			std::vector<ConnectionPoint> connections;
+
+			/**
+			 * Returns the logical net with the given name, creating it if it does
+			 * not exist yet.
+			 */
+			const LogicalNetRef& find_or_add_net(const std::string& net_name);
 
 		public:
 
@@ -543,6 +1116,13 @@ namespace gerbertools {
 			 */
 			NetlistBuilder& net(coord::CPt point, int layer, const std::string& net_name);
 
+			/**
+			 * Associates many points on the PCB with logical nets at once. The net
+			 * of each record is an index into net_names. This is equivalent to
+			 * calling net() for each record, but looks up each net name only once.
+			 */
+			NetlistBuilder& add_connections(const std::vector<std::string>& net_names, const std::vector<ConnectionRecord>& records);
+
 			/**
 			 * Builds the netlist with the given clearance. The builder should not be
 			 * used after this point.
@@ -569,23 +1149,53 @@ namespace gerbertools {
 			PhysicalNetlist connected_netlist;
 
 			/**
-			 * The physical netlist constructed from the PCB with 1/2 clearance
-			 * expansion of all copper shapes.
+			 * The minimum distance between copper of different logical nets.
 			 */
-			PhysicalNetlist clearance_netlist;
+			coord::CInt clearance;
 
 			/**
-			 * List of DRC violations detected while the netlist was built.
+			 * DRC violations detected while the netlist was built.
 			 */
-			std::list<std::string> builder_violations;
+			std::vector<Violation> builder_violations;
 
 			/**
 			 * The list of nets in this netlist.
 			 */
 			std::map<std::string, LogicalNetRef> logical_nets;
 
+			/**
+			 * The connection points that associate the logical nets with the copper.
+			 */
+			std::vector<ConnectionPoint> connections;
+
+			/**
+			 * Resolves the connection points to physical nets and associates the
+			 * logical and physical nets accordingly. Connection points without
+			 * copper are recorded as violations.
+			 */
+			void assign_connections();
+
 		public:
 
+			/**
+			 * Returns a copy of this netlist in which the copper on the given layer
+			 * (0 to N-1 for bottom to top) is replaced by the given paths, as if it
+			 * were rebuilt with the same vias and connection points. Only the work
+			 * that depends on the replaced layer is redone; see
+			 * PhysicalNetlist::replace_layer().
+			 */
+			Netlist replace_layer(size_t layer, const coord::Paths& paths) const;
+
+			/**
+			 * Runs the design-rule check and returns the violations. The checks use
+			 * up to num_threads threads (0 for the hardware concurrency), but the
+			 * result is ordered deterministically: violations
+			 * detected while building come first, followed by open circuits, short
+			 * circuits, clearance violations, and annular ring violations. If
+			 * anything is returned, the DRC failed.
+			 */
+			std::vector<Violation> check(coord::CInt annular_ring, size_t num_threads = 0) const;
+
 			/**
 			 * Runs the design-rule check. A list of violation messages is returned. If
 			 * any message is returned, the DRC failed.
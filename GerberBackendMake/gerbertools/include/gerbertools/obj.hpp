@@ -96,6 +96,29 @@ public:
 
 };
 
+/**
+ * Placement of a copy of an object file: a rotation about the origin
+ * followed by a translation, both in the XY plane.
+ */
+struct Placement {
+
+    /**
+     * Translation along X in millimeters.
+     */
+    double x = 0.0;
+
+    /**
+     * Translation along Y in millimeters.
+     */
+    double y = 0.0;
+
+    /**
+     * Counterclockwise rotation in degrees.
+     */
+    double rotation = 0.0;
+
+};
+
 // Forward declaration for an object file manager.
 class ObjFile;
 
@@ -251,6 +274,21 @@ public:
      */
     void to_file(std::ostringstream& stream) const;
 
+    /**
+     * Writes a placed copy of the contained OBJ file data to a stream that may
+     * already contain other data. vertex_base and uv_base are the number of
+     * vertices and texture coordinates written to the stream before, and are
+     * updated accordingly. Object names are prefixed with name_prefix. This
+     * allows one ObjFile to be emitted many times without rebuilding it.
+     */
+    void to_file(
+        std::ostringstream& stream,
+        const Placement &placement,
+        size_t &vertex_base,
+        size_t &uv_base,
+        const std::string &name_prefix
+    ) const;
+
 };
 
 } // namespace obj
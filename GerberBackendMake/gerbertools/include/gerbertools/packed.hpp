@@ -0,0 +1,127 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a compressed in-memory representation for sets of paths, used to
+ * keep cached geometry small while it is not being operated on.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "coord.hpp"
+
+namespace gerbertools {
+
+/**
+ * Contains a compressed in-memory representation for sets of paths.
+ */
+namespace packed {
+
+/**
+ * A set of paths stored compactly. Every path keeps its first vertex as an
+ * origin; the remaining vertices are stored as zigzag varint deltas from the
+ * previous vertex. Coordinates are in units of 1e-10 mm, so even the short
+ * steps of pads and tracks take about five bytes per axis; a vertex typically
+ * takes ten to eleven bytes rather than the sixteen of a coord::CPt, plus a
+ * header per path. Packed paths are immutable; they are expanded with
+ * unpack() whenever an operation needs them.
+ */
+class PackedPaths {
+private:
+
+    /**
+     * Per-path header.
+     */
+    struct PathHeader {
+
+        /**
+         * The first vertex of the path.
+         */
+        coord::CPt origin;
+
+        /**
+         * Number of vertices in the path, including the origin.
+         */
+        uint32_t num_vertices;
+
+        /**
+         * Offset of the encoded deltas in the data buffer.
+         */
+        uint32_t offset;
+
+    };
+
+    /**
+     * Headers for all paths.
+     */
+    std::vector<PathHeader> headers;
+
+    /**
+     * Encoded vertex deltas for all paths.
+     */
+    std::vector<uint8_t> data;
+
+    /**
+     * Total number of vertices.
+     */
+    size_t num_vertices = 0;
+
+public:
+
+    /**
+     * Constructs an empty set of packed paths.
+     */
+    PackedPaths() = default;
+
+    /**
+     * Packs the given paths.
+     */
+    explicit PackedPaths(const coord::Paths &paths);
+
+    /**
+     * Expands the packed paths.
+     */
+    coord::Paths unpack() const;
+
+    /**
+     * Returns the number of paths.
+     */
+    size_t get_num_paths() const;
+
+    /**
+     * Returns the total number of vertices.
+     */
+    size_t get_num_vertices() const;
+
+    /**
+     * Returns the approximate memory footprint in bytes.
+     */
+    size_t get_memory_usage() const;
+
+};
+
+} // namespace packed
+} // namespace gerbertools
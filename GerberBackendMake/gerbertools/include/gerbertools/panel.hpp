@@ -0,0 +1,195 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains the Panel class, which lays out copies of one or more circuit
+ * boards on a production panel.
+ */
+
+#pragma once
+
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "coord.hpp"
+#include "ncdrill.hpp"
+#include "pcb.hpp"
+
+namespace gerbertools {
+
+/**
+ * Contains the Panel class, which lays out copies of one or more circuit
+ * boards on a production panel.
+ */
+namespace panel {
+
+/**
+ * Placement of a board within a panel.
+ */
+struct Instance {
+
+    /**
+     * Index of the board, as returned by Panel::add_board().
+     */
+    size_t board;
+
+    /**
+     * Position of the board origin within the panel.
+     */
+    coord::CPt offset;
+
+    /**
+     * Counterclockwise rotation of the board about its origin, in degrees.
+     */
+    double rotation;
+
+};
+
+/**
+ * A production panel. Boards are held by reference and placed any number of
+ * times with a transform; only geometry that belongs to the panel itself
+ * (rails, tabs, V-scores, and mouse bites) is computed by the panel. Output uses
+ * instancing, so memory use and rendering time scale with the number of
+ * unique boards rather than the number of copies.
+ */
+class Panel {
+private:
+
+    /**
+     * The unique boards on this panel.
+     */
+    std::vector<std::shared_ptr<const pcb::CircuitBoard>> boards;
+
+    /**
+     * Placements of the boards.
+     */
+    std::vector<Instance> instances;
+
+    /**
+     * Panel frame material: rails and breakaway tabs.
+     */
+    coord::Paths frame;
+
+    /**
+     * Mouse bite holes. These are cut out of the frame.
+     */
+    ncdrill::HoleTable mouse_bites;
+
+    /**
+     * V-score lines.
+     */
+    std::vector<std::pair<coord::CPt, coord::CPt>> vscores;
+
+public:
+
+    /**
+     * Adds a board that can then be placed on the panel. Returns its index.
+     */
+    size_t add_board(std::shared_ptr<const pcb::CircuitBoard> board);
+
+    /**
+     * Places a copy of the given board at the given offset, rotated
+     * counterclockwise about its origin by the given number of degrees.
+     */
+    void place(size_t board, coord::CPt offset, double rotation = 0.0);
+
+    /**
+     * Places copies of the given board in a grid of the given size, with the
+     * given spacing between the boards. Returns the index of the board.
+     */
+    size_t place_grid(
+        std::shared_ptr<const pcb::CircuitBoard> board,
+        size_t columns,
+        size_t rows,
+        coord::CInt spacing,
+        double rotation = 0.0
+    );
+
+    /**
+     * Adds rails of the given width along the top and bottom of the placed
+     * boards, leaving the given gap between the boards and the rails.
+     */
+    void add_rails(coord::CInt width, coord::CInt gap);
+
+    /**
+     * Adds a breakaway tab of the given width to the frame, running straight
+     * from one given point to the other. Tabs are meant to bridge the gap
+     * between two boards or between a board and a rail.
+     */
+    void add_tab(coord::CPt from, coord::CPt to, coord::CInt width);
+
+    /**
+     * Adds a V-score line between the given points.
+     */
+    void add_vscore(coord::CPt from, coord::CPt to);
+
+    /**
+     * Adds a row of mouse bite holes of the given diameter between the given
+     * points, at the given pitch. The holes are cut out of the frame, so they
+     * only show where they cross a rail or a tab.
+     */
+    void add_mouse_bites(coord::CPt from, coord::CPt to, coord::CInt diameter, coord::CInt pitch);
+
+    /**
+     * Returns the placements of all boards.
+     */
+    const std::vector<Instance> &get_instances() const;
+
+    /**
+     * Returns the panel frame (rails and tabs), minus the mouse bites.
+     */
+    coord::Paths get_frame() const;
+
+    /**
+     * Returns the axis-aligned bounds of all placed boards.
+     */
+    coord::CRect get_board_bounds() const;
+
+    /**
+     * Returns the axis-aligned bounds of the panel.
+     */
+    coord::CRect get_bounds() const;
+
+    /**
+     * Renders the panel to an SVG. Every unique board is rendered once into the
+     * SVG definitions and referenced by each of its placements. Throws if the
+     * panel has neither boards nor a frame.
+     */
+    void write_svg(
+        std::ostringstream &stream,
+        bool flipped,
+        double scale,
+        const pcb::ColorScheme &colors = {}
+    ) const;
+
+    /**
+     * Renders the panel to a Wavefront OBJ file. The geometry of every unique
+     * board is built once and written out transformed for each placement.
+     */
+    void write_obj(std::ostringstream &stream) const;
+
+};
+
+} // namespace panel
+} // namespace gerbertools
@@ -0,0 +1,153 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a small dependency-graph scheduler and parallel loop helper, used to
+ * spread independent geometry operations over all available cores.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace gerbertools {
+
+/**
+ * Contains a small dependency-graph scheduler and parallel loop helper.
+ */
+namespace parallel {
+
+/**
+ * Identifier for a stage within a TaskGraph.
+ */
+using StageId = size_t;
+
+/**
+ * Timing information for a stage that was executed by a TaskGraph.
+ */
+struct StageTiming {
+
+    /**
+     * Name of the stage.
+     */
+    std::string name;
+
+    /**
+     * Time at which the stage started, in milliseconds since the graph
+     * started running.
+     */
+    double start_ms;
+
+    /**
+     * Time that the stage took to complete, in milliseconds.
+     */
+    double duration_ms;
+
+};
+
+/**
+ * Returns the number of worker threads to use for the given request. Zero
+ * means all available cores.
+ */
+size_t get_num_threads(size_t requested = 0);
+
+/**
+ * Represents a directed acyclic graph of named stages. Each stage runs once all
+ * the stages it depends on have completed; independent stages run concurrently
+ * on a pool of worker threads.
+ */
+class TaskGraph {
+private:
+
+    /**
+     * A single stage in the graph.
+     */
+    struct Stage {
+
+        /**
+         * Name of the stage, for timing reports.
+         */
+        std::string name;
+
+        /**
+         * The work to do.
+         */
+        std::function<void()> fn;
+
+        /**
+         * The stages that depend on this one.
+         */
+        std::vector<StageId> dependents;
+
+        /**
+         * The number of stages this stage depends on.
+         */
+        size_t num_dependencies;
+
+    };
+
+    /**
+     * All stages in the graph, in the order they were added.
+     */
+    std::vector<Stage> stages;
+
+    /**
+     * Timing information for each stage after run() completes, in the order
+     * the stages were added.
+     */
+    std::vector<StageTiming> timings;
+
+public:
+
+    /**
+     * Adds a stage to the graph. The dependencies must have been added before.
+     * Returns an identifier that can be used as a dependency for later stages.
+     */
+    StageId add(const std::string &name, std::function<void()> fn, const std::vector<StageId> &dependencies = {});
+
+    /**
+     * Runs all stages using the given number of threads (zero for all
+     * available cores). If any stage throws, no further stages are started,
+     * and the first exception is rethrown once the running stages complete.
+     */
+    void run(size_t num_threads = 0);
+
+    /**
+     * Returns the timing information for all stages of the last run.
+     */
+    const std::vector<StageTiming> &get_timings() const;
+
+};
+
+/**
+ * Calls fn for every index in [0, count) using the given number of threads
+ * (zero for all available cores). If any call throws, the first exception is
+ * rethrown after all threads are done.
+ */
+void for_each(size_t count, const std::function<void(size_t)> &fn, size_t num_threads = 0);
+
+} // namespace parallel
+} // namespace gerbertools
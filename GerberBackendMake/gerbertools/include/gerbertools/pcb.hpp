@@ -30,14 +30,21 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include "coord.hpp"
+#include "gerber.hpp"
 #include "color.hpp"
 #include "svg.hpp"
 #include "obj.hpp"
 #include "netlist.hpp"
 #include "ncdrill.hpp"
+#include "parallel.hpp"
+#include "cache.hpp"
+#include "packed.hpp"
 
 namespace gerbertools {
 
@@ -52,6 +59,101 @@ namespace gerbertools {
 		 */
 		static const double COPPER_OZ = 0.0348;
 
+		/**
+		 * Role of a layer within the board stackup.
+		 */
+		enum class LayerRole {
+
+			/**
+			 * Bottom solder mask.
+			 */
+			BOTTOM_MASK,
+
+			/**
+			 * Bottom silkscreen.
+			 */
+			BOTTOM_SILK,
+
+			/**
+			 * Bottom copper.
+			 */
+			BOTTOM_COPPER,
+
+			/**
+			 * Substrate; numbered bottom-up starting from 1.
+			 */
+			SUBSTRATE,
+
+			/**
+			 * Inner copper; numbered top-down starting from 1.
+			 */
+			INNER_COPPER,
+
+			/**
+			 * Top copper.
+			 */
+			TOP_COPPER,
+
+			/**
+			 * Top silkscreen.
+			 */
+			TOP_SILK,
+
+			/**
+			 * Top solder mask.
+			 */
+			TOP_MASK
+
+		};
+
+		/**
+		 * Identifies a layer by its role and, for roles that can occur more than
+		 * once, its index. The identifier is short and stable, so it can be used
+		 * for SVG and OBJ element names.
+		 */
+		class LayerId {
+		private:
+
+			/**
+			 * The role of the layer.
+			 */
+			LayerRole role;
+
+			/**
+			 * Index for inner copper and substrate layers; zero otherwise.
+			 */
+			size_t index;
+
+		public:
+
+			/**
+			 * Constructs a layer identifier.
+			 */
+			LayerId(LayerRole role, size_t index = 0);
+
+			/**
+			 * Returns the role of the layer.
+			 */
+			LayerRole get_role() const;
+
+			/**
+			 * Returns the index of the layer.
+			 */
+			size_t get_index() const;
+
+			/**
+			 * Returns whether this is a bottom-side layer.
+			 */
+			bool is_bottom() const;
+
+			/**
+			 * Returns the identifier as a string, for example "copper_top",
+			 * "mask_bottom", "copper_inner1", or "substrate1".
+			 */
+			std::string to_string() const;
+
+		};
+
 		/**
 		 * A PCB color scheme.
 		 */
@@ -96,6 +198,58 @@ namespace gerbertools {
 
 		};
 
+		/**
+		 * A lazily computed, memoized value. The value is computed the first time
+		 * it is requested; concurrent requests block until it is available, so a
+		 * const object can safely be shared between threads.
+		 */
+		template <typename T>
+		class Lazy {
+		private:
+
+			/**
+			 * Guards the computation.
+			 */
+			mutable std::once_flag once;
+
+			/**
+			 * Function that computes the value. Released once it has been called.
+			 */
+			mutable std::function<T()> compute;
+
+			/**
+			 * The value, once computed.
+			 */
+			mutable T value;
+
+		public:
+
+			/**
+			 * Constructs a lazy value from the function that computes it.
+			 */
+			explicit Lazy(std::function<T()> compute) : compute(std::move(compute)) {}
+
+			/**
+			 * Returns the value, computing it first if needed.
+			 */
+			const T& get() const {
+				std::call_once(once, [this]() {
+					value = compute();
+					compute = nullptr;
+				});
+				return value;
+			}
+
+		};
+
+		/**
+		 * Function producing shared paths. Layers take their input geometry in
+		 * this form and only call it on first use, so geometry that still has to
+		 * be decoded, such as that of an expanded PackedBoard, is only decoded
+		 * when a product actually reads it.
+		 */
+		using PathsSource = std::function<coord::PathsRef()>;
+
 		/**
 		 * Represents any PCB layer type.
 		 */
@@ -103,7 +257,12 @@ namespace gerbertools {
 		private:
 
 			/**
-			 * The layer name.
+			 * The layer identifier.
+			 */
+			LayerId id;
+
+			/**
+			 * The layer name, derived from the identifier.
 			 */
 			std::string name;
 
@@ -117,15 +276,20 @@ namespace gerbertools {
 			/**
 			 * Constructs a layer.
 			 */
-			explicit Layer(const std::string& name, double thickness);
+			explicit Layer(const LayerId& id, double thickness);
 
 		public:
 			virtual ~Layer() = default;
 
+			/**
+			 * Returns the identifier for the layer.
+			 */
+			const LayerId& get_id() const;
+
 			/**
 			 * Returns a name for the layer.
 			 */
-			std::string get_name() const;
+			const std::string& get_name() const;
 
 			/**
 			 * Returns the thickness of this layer.
@@ -135,7 +299,7 @@ namespace gerbertools {
 			/**
 			 * Returns the surface finish mask for this layer.
 			 */
-			virtual coord::Paths get_mask() const = 0;
+			virtual const coord::Paths& get_mask() const = 0;
 
 			/**
 			 * Renders the layer to an SVG layer.
@@ -147,6 +311,12 @@ namespace gerbertools {
 			 */
 			virtual void to_obj(obj::ObjFile& obj, size_t layer_index, double z, const std::string& id_prefix) const = 0;
 
+			/**
+			 * Computes all geometry of the layer that is otherwise computed on first
+			 * use.
+			 */
+			virtual void finalize() const;
+
 		};
 
 		/**
@@ -163,35 +333,35 @@ namespace gerbertools {
 			/**
 			 * The board shape, minus holes after plating.
 			 */
-			coord::Paths shape;
+			coord::PathsRef shape;
 
 			/**
 			 * The board outline, minus holes before plating.
 			 */
-			coord::Paths dielectric;
+			coord::PathsRef dielectric;
 
 			/**
 			 * Substrate plating; i.e. copper on the sides of the substrate dielectric.
 			 */
-			coord::Paths plating;
+			coord::PathsRef plating;
 
 		public:
 
 			/**
-			 * Constructs a substrate layer.
+			 * Constructs a substrate layer. The geometry is shared with the board.
 			 */
 			explicit SubstrateLayer(
-				const std::string& name,
-				const coord::Paths& shape,
-				const coord::Paths& dielectric,
-				const coord::Paths& plating,
+				const LayerId& id,
+				const coord::PathsRef& shape,
+				const coord::PathsRef& dielectric,
+				const coord::PathsRef& plating,
 				double thickness
 			);
 
 			/**
 			 * Returns the surface finish mask for this layer.
 			 */
-			coord::Paths get_mask() const override;
+			const coord::Paths& get_mask() const override;
 
 			/**
 			 * Renders the layer to an SVG layer.
@@ -205,6 +375,11 @@ namespace gerbertools {
 
 		};
 
+		/**
+		 * Shared reference to the net-tagged objects of a Gerber file.
+		 */
+		using NetObjectsRef = std::shared_ptr<const std::vector<gerber::NetObject>>;
+
 		/**
 		 * Represents a copper layer.
 		 */
@@ -212,38 +387,58 @@ namespace gerbertools {
 		private:
 
 			/**
-			 * Shape of the copper as specified in the Gerber file.
+			 * Shape of the copper as specified in the Gerber file. Obtained from its
+			 * source on first use.
+			 */
+			Lazy<coord::PathsRef> layer;
+
+			/**
+			 * The board shape, minus holes after plating. Shared with the board.
+			 */
+			coord::PathsRef board_shape;
+
+			/**
+			 * The board shape, with cutouts for non-plated holes, but not for plated
+			 * holes/vias. Shared with the board.
 			 */
-			coord::Paths layer;
+			coord::PathsRef board_shape_excl_pth;
 
 			/**
 			 * Actual shape of the copper. That is, layer minus board outline and all
-			 * finished holes.
+			 * finished holes. Computed on first use.
 			 */
-			coord::Paths copper;
+			Lazy<coord::Paths> copper;
 
 			/**
-			 * As above, but without cutouts for plated holes.
+			 * As above, but without cutouts for plated holes. Computed on first use.
 			 */
-			coord::Paths copper_excl_pth;
+			Lazy<coord::Paths> copper_excl_pth;
+
+			/**
+			 * The objects that were tagged with a net name via Gerber X2 attributes,
+			 * if any.
+			 */
+			NetObjectsRef net_objects;
 
 		public:
 
 			/**
-			 * Constructs a copper layer.
+			 * Constructs a copper layer. The geometry and net objects are shared, not
+			 * copied.
 			 */
 			CopperLayer(
-				const std::string& name,
-				const coord::Paths& board_shape,
-				const coord::Paths& board_shape_excl_pth,
-				const coord::Paths& copper_layer,
-				double thickness
+				const LayerId& id,
+				const coord::PathsRef& board_shape,
+				const coord::PathsRef& board_shape_excl_pth,
+				const PathsSource& copper_layer,
+				double thickness,
+				const NetObjectsRef& net_objects = nullptr
 			);
 
 			/**
 			 * Returns the surface finish mask for this layer.
 			 */
-			coord::Paths get_mask() const override;
+			const coord::Paths& get_mask() const override;
 
 			/**
 			 * Returns the copper for this layer.
@@ -261,6 +456,12 @@ namespace gerbertools {
 			 */
 			const coord::Paths& get_layer() const;
 
+			/**
+			 * Returns the objects that were tagged with a net name via Gerber X2
+			 * attributes, or null if the Gerber file had none.
+			 */
+			const NetObjectsRef& get_net_objects() const;
+
 			/**
 			 * Renders the layer to an SVG layer.
 			 */
@@ -271,6 +472,12 @@ namespace gerbertools {
 			 */
 			void to_obj(obj::ObjFile& obj, size_t layer_index, double z, const std::string& id_prefix) const override;
 
+			/**
+			 * Computes all geometry of the layer that is otherwise computed on first
+			 * use.
+			 */
+			void finalize() const override;
+
 		};
 
 		/**
@@ -281,15 +488,21 @@ namespace gerbertools {
 
 			/**
 			 * Shape of the mask. Intersection of the solder mask Gerber file and the
-			 * board outline.
+			 * board outline. Obtained from its source on first use.
+			 */
+			Lazy<coord::PathsRef> mask;
+
+			/**
+			 * The silkscreen layer as specified in the Gerber file. Obtained from its
+			 * source on first use.
 			 */
-			coord::Paths mask;
+			Lazy<coord::PathsRef> silk_layer;
 
 			/**
 			 * Shape of the silkscreen. Intersection of the above solder mask shape and
-			 * the silkscreen layer.
+			 * the silkscreen layer. Computed on first use.
 			 */
-			coord::Paths silk;
+			Lazy<coord::Paths> silk;
 
 			/**
 			 * Whether this mask layer is at the bottom (true) or top (false).
@@ -303,17 +516,30 @@ namespace gerbertools {
 			 * Constructs a solder mask.
 			 */
 			MaskLayer(
-				const std::string& name,
+				const LayerId& id,
 				const coord::Paths& board_outline,
 				const coord::Paths& mask_layer,
-				const coord::Paths& silk_layer,
-				bool bottom
+				const PathsSource& silk_layer
+			);
+
+			/**
+			 * Constructs a solder mask from an already derived mask shape.
+			 */
+			MaskLayer(
+				const LayerId& id,
+				const PathsSource& mask,
+				const PathsSource& silk_layer
 			);
 
 			/**
 			 * Returns the surface finish mask for this layer.
 			 */
-			coord::Paths get_mask() const override;
+			const coord::Paths& get_mask() const override;
+
+			/**
+			 * Returns the silkscreen layer as specified in the Gerber file.
+			 */
+			const coord::Paths& get_silk_layer() const;
 
 			/**
 			 * Renders the layer to an SVG layer.
@@ -325,13 +551,176 @@ namespace gerbertools {
 			 */
 			void to_obj(obj::ObjFile& obj, size_t layer_index, double z, const std::string& id_prefix) const override;
 
+			/**
+			 * Computes all geometry of the layer that is otherwise computed on first
+			 * use.
+			 */
+			void finalize() const override;
+
+		};
+
+		/**
+		 * Flags selecting the outputs produced by CircuitBoard::render().
+		 */
+		enum OutputFlags : unsigned {
+
+			/**
+			 * SVG rendering of the top side.
+			 */
+			OUTPUT_FRONT_SVG = 1u << 0,
+
+			/**
+			 * SVG rendering of the bottom side.
+			 */
+			OUTPUT_BACK_SVG = 1u << 1,
+
+			/**
+			 * Wavefront material library for the OBJ file.
+			 */
+			OUTPUT_MTL = 1u << 2,
+
+			/**
+			 * Wavefront OBJ model.
+			 */
+			OUTPUT_OBJ = 1u << 3,
+
+			/**
+			 * All of the above.
+			 */
+			OUTPUT_ALL = OUTPUT_FRONT_SVG | OUTPUT_BACK_SVG | OUTPUT_MTL | OUTPUT_OBJ
+
+		};
+
+		/**
+		 * The outputs produced by CircuitBoard::render(). Outputs that were not
+		 * requested are left empty.
+		 */
+		struct RenderedOutputs {
+
+			/**
+			 * SVG rendering of the top side.
+			 */
+			std::string front_svg;
+
+			/**
+			 * SVG rendering of the bottom side.
+			 */
+			std::string back_svg;
+
+			/**
+			 * Wavefront material library.
+			 */
+			std::string mtl;
+
+			/**
+			 * Wavefront OBJ model.
+			 */
+			std::string obj;
+
 		};
 
 		/**
-		 * Represents a circuit board.
+		 * Describes the layer stack of a board in terms of its copper layers and
+		 * the dielectric (core or prepreg) between them.
+		 */
+		struct Stackup {
+
+			/**
+			 * Thickness of each copper layer in millimeters, top-down.
+			 */
+			std::vector<double> copper;
+
+			/**
+			 * Thickness of each dielectric layer in millimeters, top-down. Element
+			 * i separates copper layers i and i + 1, so there is one fewer than
+			 * there are copper layers.
+			 */
+			std::vector<double> dielectric;
+
+			/**
+			 * Returns a stackup for the given number of copper layers, with 1oz
+			 * copper and a total dielectric thickness of 1.5mm divided equally.
+			 */
+			static Stackup standard(size_t num_copper_layers);
+
+		};
+
+		/**
+		 * File contents by role, as views of buffers owned by the caller.
+		 */
+		using FileViews = std::map<std::string, std::vector<std::string_view>>;
+
+		/**
+		 * The paths and net-tagged objects parsed from a Gerber file.
+		 */
+		struct ParsedGerber {
+
+			/**
+			 * The image, or the outline for outline files.
+			 */
+			coord::PathsRef paths;
+
+			/**
+			 * The objects that were tagged with a net name via X2 attributes, or
+			 * null if there were none.
+			 */
+			NetObjectsRef net_objects;
+
+		};
+
+		/**
+		 * The physical netlist of a board along with a name for each of its nets,
+		 * taken from the Gerber X2 net attributes of the copper layers. Filled in
+		 * on first use.
+		 */
+		struct NamedNetlist {
+
+			/**
+			 * Guards the computation.
+			 */
+			std::once_flag once;
+
+			/**
+			 * The physical netlist.
+			 */
+			netlist::PhysicalNetlist netlist;
+
+			/**
+			 * The name of each net, by id. Empty for nets without tagged objects.
+			 */
+			std::vector<std::string> names;
+
+		};
+
+		/**
+		 * The holes and vias parsed from an NC drill file.
+		 */
+		struct ParsedDrill {
+
+			/**
+			 * All drilled and routed holes.
+			 */
+			ncdrill::HoleTable holes;
+
+			/**
+			 * Points representing vias.
+			 */
+			std::list<ncdrill::Via> vias;
+
+		};
+
+		class ParseCache;
+		class PackedBoard;
+
+		/**
+		 * Represents a circuit board. All derived geometry is held in shared,
+		 * immutable buffers, so copying a board or handing geometry to a layer
+		 * does not duplicate any polygons.
 		 */
 		class CircuitBoard {
 		private:
+			friend class ParseCache;
+			friend class PackedBoard;
 
 			/**
 			 * Prefix for all filenames.
@@ -340,38 +729,44 @@ namespace gerbertools {
 			/**
 			 * The board outline, without removal of holes.
 			 */
-			coord::Paths board_outline;
+			coord::PathsRef board_outline;
 
 			/**
 			 * The board shape, minus holes after plating.
 			 */
-			coord::Paths board_shape;
+			coord::PathsRef board_shape;
 
 			/**
 			 * The board shape, with cutouts for non-plated holes, but not for plated
 			 * holes/vias.
 			 */
-			coord::Paths board_shape_excl_pth;
+			coord::PathsRef board_shape_excl_pth;
 
 			/**
 			 * The board outline, minus holes before plating.
 			 */
-			coord::Paths substrate_dielectric;
+			coord::PathsRef substrate_dielectric;
 
 			/**
 			 * Substrate plating; i.e. copper on the sides of the substrate dielectric.
 			 */
-			coord::Paths substrate_plating;
+			coord::PathsRef substrate_plating;
+
+			/**
+			 * Copper surface finish on the bottom of the PCB. Computed on first use.
+			 */
+			std::shared_ptr<const Lazy<coord::Paths>> bottom_finish;
 
 			/**
-			 * Copper surface finish on the bottom of the PCB.
+			 * Copper surface finish on the top of the PCB. Computed on first use.
 			 */
-			coord::Paths bottom_finish;
+			std::shared_ptr<const Lazy<coord::Paths>> top_finish;
 
 			/**
-			 * Copper surface finish on the top of the PCB.
+			 * All drilled and routed holes, kept as primitives. These are only
+			 * polygonized where a boolean operation needs them.
 			 */
-			coord::Paths top_finish;
+			ncdrill::HoleTable holes;
 
 			/**
 			 * Points representing vias.
@@ -394,21 +789,84 @@ namespace gerbertools {
 			 */
 			size_t num_substrate_layers;
 
+			/**
+			 * Per-stage timings of the task graph that built this board, if it was
+			 * built by LoadPCB().
+			 */
+			std::vector<parallel::StageTiming> build_timings;
+
+			/**
+			 * The physical netlist named after the X2 net attributes, as used by
+			 * build_obj(). Computed on first use, and replaced whenever a layer or
+			 * drill file is added.
+			 */
+			std::shared_ptr<NamedNetlist> named_netlist = std::make_shared<NamedNetlist>();
+
+			/**
+			 * Constructs an empty circuit board, to be filled in by LoadPCB().
+			 */
+			explicit CircuitBoard(double plating_thickness);
+
 			/**
 			 * Returns an open file input stream for the given filename.
 			 */
-			std::istringstream read_file(const std::string& buffer);
+			static std::istringstream read_file(const std::string& buffer);
 
 			/**
 			 * Reads a Gerber file.
 			 */
-			coord::Paths read_gerber(const std::string& fname, bool outline = false);
+			static coord::Paths read_gerber(std::string_view data, bool outline = false);
+
+			/**
+			 * Parses a Gerber file, keeping the objects that were tagged with a net
+			 * name along with the paths.
+			 */
+			static ParsedGerber parse_gerber(std::string_view data, bool outline = false);
+
+
+			/**
+			 * Parses an NC drill file.
+			 */
+			static ParsedDrill parse_drill(std::string_view data, bool plated);
 
+			/**
+			 * Appends the holes and vias of a parsed drill file.
+			 */
+			void add_drill(const ParsedDrill& drill);
 
 			/**
-			 * Reads an NC drill file.
+			 * Reads an NC drill file, appending its holes to the hole table.
 			 */
-			void read_drill(const std::string& fname, bool plated, coord::Paths& pth, coord::Paths& npth);
+			void read_drill(std::string_view data, bool plated);
+
+			/**
+			 * Derives board_shape, board_shape_excl_pth, substrate_dielectric and
+			 * substrate_plating from the board outline and the hole table in one
+			 * go, reusing intermediate results between them.
+			 */
+			void derive_board_shape();
+
+			/**
+			 * Computes the board-clipped copper of all copper layers concurrently on
+			 * the given number of threads (zero for all available cores), ahead of
+			 * operations that need all of them.
+			 */
+			void prepare_copper(size_t num_threads = 0) const;
+
+			/**
+			 * Reconstructs a stored layer on top of this board's geometry. The paths
+			 * are the copper as drawn for copper layers, and the mask shape for mask
+			 * layers; silk is only used for mask layers. Neither is obtained from its
+			 * source until the layer needs it.
+			 */
+			LayerRef make_stored_layer(
+				unsigned type,
+				const LayerId& id,
+				double thickness,
+				const PathsSource& paths,
+				const PathsSource& silk,
+				const NetObjectsRef& net_objects = nullptr
+			) const;
 
 		public:
 
@@ -441,17 +899,63 @@ namespace gerbertools {
 				double plating_thickness = 0.5 * COPPER_OZ
 			);
 
-			static CircuitBoard LoadPCB(std::map<std::string, std::vector<std::string>>& files);
+			/**
+			 * Builds a complete board from a map of file contents by role (outline,
+			 * drill, bottomMask, bottomSilk, bottomCopper, innerCopper, topCopper,
+			 * topMask, topSilk). innerCopper may hold any number of files, ordered
+			 * top-down. The stackup must have as many copper layers as there are
+			 * inner layers plus two; if none is given, the standard one is used.
+			 * The file contents are parsed in place, without being copied, so they
+			 * must stay alive until this returns. Once the files are known, the
+			 * build is a dependency graph: parsing of every file is independent, the
+			 * board shape depends on outline and drills, copper layers depend on the
+			 * board shape, masks only on outline, mask and silk, and the surface
+			 * finish on all of those. Independent stages run concurrently on the
+			 * given number of threads (zero for all available cores). If a parse
+			 * cache is given, only files that are not in it are parsed.
+			 */
+			static CircuitBoard LoadPCB(
+				const FileViews& files,
+				size_t num_threads = 0,
+				ParseCache* parse_cache = nullptr,
+				const Stackup* stackup = nullptr
+			);
+
+			/**
+			 * As LoadPCB() for file views, but for file contents held in strings.
+			 * The map is cleared afterwards.
+			 */
+			static CircuitBoard LoadPCB(
+				std::map<std::string, std::vector<std::string>>& files,
+				size_t num_threads = 0,
+				ParseCache* parse_cache = nullptr,
+				const Stackup* stackup = nullptr
+			);
+
+			/**
+			 * As LoadPCB() for file views, but takes ownership of the file contents,
+			 * which are released once the board has been built.
+			 */
+			static CircuitBoard LoadPCB(
+				std::map<std::string, std::vector<std::string>>&& files,
+				size_t num_threads = 0,
+				ParseCache* parse_cache = nullptr,
+				const Stackup* stackup = nullptr
+			);
 
 			/**
-			 * Adds a mask layer to the board. Layers are added bottom-up.
+			 * Adds a mask layer to the board, given the contents of the mask and
+			 * silkscreen Gerber files. The role must be BOTTOM_MASK or TOP_MASK.
+			 * Layers are added bottom-up.
 			 */
-			void add_mask_layer(std::string& mask, const std::string& silk);
+			void add_mask_layer(LayerRole role, std::string_view mask, std::string_view silk = {});
 
 			/**
-			 * Adds a copper layer to the board. Layers are added bottom-up.
+			 * Adds a copper layer to the board, given the contents of its Gerber
+			 * file. The role must be BOTTOM_COPPER, INNER_COPPER, or TOP_COPPER.
+			 * Layers are added bottom-up.
 			 */
-			void add_copper_layer(std::string& gerber, double thickness = COPPER_OZ);
+			void add_copper_layer(const LayerId& id, std::string_view gerber, double thickness = COPPER_OZ);
 
 			/**
 			 * Adds a substrate layer. Layers are added bottom-up.
@@ -459,7 +963,8 @@ namespace gerbertools {
 			void add_substrate_layer(double thickness = 1.5);
 
 			/**
-			 * Derives the surface finish layer for all exposed copper.
+			 * Derives the surface finish layer for all exposed copper. The finish is
+			 * computed on first use, for the layers added thus far.
 			 */
 			void add_surface_finish();
 
@@ -467,14 +972,51 @@ namespace gerbertools {
 
 			/**
 			 * Returns a netlist builder initialized with the vias and copper regions of
-			 * this PCB.
+			 * this PCB. The copper is computed on the given number of threads (zero
+			 * for all available cores).
+			 */
+			netlist::NetlistBuilder get_netlist_builder(size_t num_threads = 0) const;
+
+			/**
+			 * Returns whether any of the copper layers was tagged with net names
+			 * via Gerber X2 attributes.
 			 */
-			netlist::NetlistBuilder get_netlist_builder() const;
+			bool has_net_attributes() const;
 
 			/**
-			 * Returns the physical netlist for this PCB.
+			 * Returns a netlist builder initialized as for get_netlist_builder(),
+			 * with a connection point for every flash and draw that was tagged with
+			 * a net name via Gerber X2 attributes. This yields the logical netlist
+			 * without an external netlist file, for design rule checks. Building it
+			 * resolves every tagged object; build_obj() only needs one name per
+			 * net and uses get_named_netlist() instead.
 			 */
-			netlist::PhysicalNetlist get_physical_netlist() const;
+			netlist::NetlistBuilder get_attribute_netlist_builder(size_t num_threads = 0) const;
+
+			/**
+			 * Returns the physical netlist with each net named after a flash or
+			 * draw on it that was tagged with a net name via Gerber X2 attributes.
+			 * The result is cached; the copper is computed on the given number of
+			 * threads (zero for all available cores) when it is first needed.
+			 */
+			const NamedNetlist& get_named_netlist(size_t num_threads = 0) const;
+
+			/**
+			 * Returns the physical netlist for this PCB. The copper is computed on
+			 * the given number of threads (zero for all available cores).
+			 */
+			netlist::PhysicalNetlist get_physical_netlist(size_t num_threads = 0) const;
+
+			/**
+			 * Returns all drilled and routed holes as primitives.
+			 */
+			const ncdrill::HoleTable& get_holes() const;
+
+			/**
+			 * Returns the per-stage timings of the task graph that built this
+			 * board. Empty if the board was not built by LoadPCB().
+			 */
+			const std::vector<parallel::StageTiming>& get_build_timings() const;
 
 			/**
 			 * Returns the axis-aligned boundary coordinates of the PCB.
@@ -483,24 +1025,210 @@ namespace gerbertools {
 
 			/**
 			 * Renders the circuit board to SVG, returning only the body of it, allowing it
-			 * to be composited into a larger image.
+			 * to be composited into a larger image. The layers are rendered on the
+			 * given number of threads (zero for all available cores).
 			 */
-			std::string get_svg(bool flipped, const ColorScheme& colors, const std::string& id_prefix = "") const;
+			std::string get_svg(bool flipped, const ColorScheme& colors, const std::string& id_prefix = "", size_t num_threads = 0) const;
 
 			/**
-			 * Renders the circuit board to an SVG.
+			 * Renders the circuit board to an SVG, using the given number of threads
+			 * as for get_svg().
 			 */
 			void write_svg(std::ostringstream& stream,
 				bool flipped,
 				double scale,
-				const ColorScheme& colors = {}) const;
+				const ColorScheme& colors = {},
+				size_t num_threads = 0) const;
 
 			/**
 			 * Renders the circuit board to a Wavefront OBJ file. Optionally, a netlist
 			 * can be supplied, of which the logical net names will then be used to
-			 * name the copper objects.
+			 * name the copper objects. Without one, the names are taken from Gerber
+			 * X2 net attributes, if the copper layers have them. The copper is
+			 * computed on the given number of threads (zero for all available cores).
+			 */
+			void write_obj(std::ostringstream& stream, const netlist::Netlist* netlist = nullptr, size_t num_threads = 0) const;
+
+			/**
+			 * Adds the 3D geometry of the circuit board to the given OBJ file, for
+			 * callers that write it out themselves. The netlist and thread count are
+			 * used as for write_obj().
+			 */
+			void build_obj(obj::ObjFile& obj, const netlist::Netlist* netlist = nullptr, size_t num_threads = 0) const;
+
+			/**
+			 * Returns the total thickness of the layer stack in millimeters.
+			 */
+			double get_thickness() const;
+
+			/**
+			 * Produces the requested subset of outputs (a combination of
+			 * OutputFlags) from this board. The outputs are independent, so they
+			 * are generated concurrently on the given number of threads (zero for
+			 * all available cores). SVGs are rendered at the given scale.
+			 */
+			RenderedOutputs render(unsigned outputs, double svg_scale = 2.0, size_t num_threads = 0) const;
+
+			/**
+			 * Serializes the board to the binary snapshot format (see snapshot.hpp).
+			 * The snapshot contains the board geometry, holes, vias, layer stack,
+			 * and the objects that were tagged with a net name via Gerber X2
+			 * attributes; products that are computed on first use are not stored.
+			 */
+			std::string write_snapshot() const;
+
+			/**
+			 * Reconstructs a board from a snapshot produced by write_snapshot().
+			 * The data is only read during this call, so it may be mmapped.
+			 */
+			static CircuitBoard read_snapshot(std::string_view data);
+
+			/**
+			 * Converts the board to its compressed in-memory form. Products that are
+			 * computed on first use are not kept.
+			 */
+			PackedBoard pack() const;
+
+			/**
+			 * Computes everything that is otherwise computed on first use, using the
+			 * given number of threads (zero for all available cores), and returns
+			 * the result as an immutable board. Rendering a frozen board only reads
+			 * from it, so a single instance can serve any number of concurrent
+			 * requests without locking or copying.
+			 */
+			std::shared_ptr<const CircuitBoard> freeze(size_t num_threads = 0) const;
+
+		};
+
+		/**
+		 * A circuit board with all geometry held as packed paths, for keeping
+		 * boards in a cache at a fraction of their expanded size. Use expand()
+		 * to get a CircuitBoard back when a board is actually needed.
+		 */
+		class PackedBoard {
+		private:
+			friend class CircuitBoard;
+
+			/**
+			 * A layer of the stack, along with the geometry it was built from. The
+			 * geometry is shared with the boards expanded from this one, which
+			 * decode it on first use.
+			 */
+			struct StoredLayer {
+				unsigned type;
+				LayerId id;
+				double thickness;
+				std::shared_ptr<const packed::PackedPaths> paths;
+				std::shared_ptr<const packed::PackedPaths> silk;
+				NetObjectsRef net_objects;
+			};
+
+			/**
+			 * Plating thickness for vias.
+			 */
+			coord::CInt plating_thickness = 0;
+
+			/**
+			 * The total number of substrate layers.
+			 */
+			size_t num_substrate_layers = 0;
+
+			/**
+			 * Board geometry; see CircuitBoard.
+			 */
+			packed::PackedPaths board_outline;
+			packed::PackedPaths board_shape;
+			packed::PackedPaths board_shape_excl_pth;
+			packed::PackedPaths substrate_dielectric;
+			packed::PackedPaths substrate_plating;
+
+			/**
+			 * All drilled and routed holes.
+			 */
+			ncdrill::HoleTable holes;
+
+			/**
+			 * Points representing vias.
+			 */
+			std::list<ncdrill::Via> vias;
+
+			/**
+			 * The layer stack, bottom-up.
+			 */
+			std::vector<StoredLayer> layers;
+
+		public:
+
+			/**
+			 * Returns the approximate memory footprint in bytes.
+			 */
+			size_t get_memory_usage() const;
+
+			/**
+			 * Expands the board back into a CircuitBoard. The board geometry is
+			 * decoded concurrently on the given number of threads (zero for all
+			 * available cores); the geometry of each layer is only decoded when a
+			 * product first reads it.
+			 */
+			CircuitBoard expand(size_t num_threads = 0) const;
+
+		};
+
+		/**
+		 * Cache of parsed Gerber and NC drill files, keyed by a hash of the file
+		 * contents and the parse options. Passing the same cache to successive
+		 * LoadPCB() calls means that only files that changed are parsed again;
+		 * the booleans that depend on them are always redone. Thread-safe.
+		 */
+		class ParseCache {
+		private:
+
+			/**
+			 * A cached parse result; either a Gerber file or a drill file.
+			 */
+			struct Entry {
+				ParsedGerber gerber;
+				std::shared_ptr<const ParsedDrill> drill;
+			};
+
+			/**
+			 * The cached parse results.
+			 */
+			cache::LruCache<uint64_t, Entry> entries;
+
+		public:
+
+			/**
+			 * Constructs a parse cache with the given memory budget in bytes.
+			 */
+			explicit ParseCache(size_t budget);
+
+			/**
+			 * Returns the paths and net-tagged objects for the given Gerber file,
+			 * parsing it if needed.
+			 */
+			ParsedGerber get_gerber(std::string_view data, bool outline = false);
+
+			/**
+			 * Returns the holes and vias for the given NC drill file, parsing it if
+			 * needed.
+			 */
+			std::shared_ptr<const ParsedDrill> get_drill(std::string_view data, bool plated);
+
+			/**
+			 * Changes the memory budget, evicting entries as needed.
+			 */
+			void set_budget(size_t budget);
+
+			/**
+			 * Removes all entries.
+			 */
+			void clear();
+
+			/**
+			 * Returns the hit/miss statistics of the cache.
 			 */
-			void write_obj(std::ostringstream& stream, const netlist::Netlist* netlist = nullptr) const;
+			cache::CacheStats get_stats() const;
 
 		};
 
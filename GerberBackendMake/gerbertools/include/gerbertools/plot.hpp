@@ -155,6 +155,14 @@ public:
      */
     const coord::Paths &get_clear() const;
 
+    /**
+     * Commits and simplifies all paths drawn so far, such that get_dark() and
+     * get_clear() no longer modify the plot. Once finalized, a plot may be
+     * read from multiple threads concurrently, as long as nothing more is
+     * drawn to it.
+     */
+    void finalize();
+
 };
 
 /**
@@ -0,0 +1,255 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains the building blocks for the binary board snapshot format: a
+ * delta/varint encoder and decoder for geometry, and a section table that
+ * allows individual sections to be located without decoding the others.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "coord.hpp"
+
+namespace gerbertools {
+
+/**
+ * Contains the building blocks for the binary board snapshot format.
+ *
+ * A snapshot starts with a 16-byte header: the magic "GTBS", the format
+ * version, the number of sections, and a reserved word, all as little-endian
+ * 32-bit integers. The header is followed by the section table, with for each
+ * section a 32-bit tag, a reserved 32-bit word, and 64-bit offset and size.
+ * Section data follows the table, with every section aligned to 8 bytes. The
+ * layout is position-independent, so a snapshot can be mmapped and individual
+ * sections decoded on demand.
+ *
+ * Within a section, integers are LEB128 varints, signed integers are
+ * zigzag-encoded first, and floating point values are stored as 8 raw
+ * little-endian bytes. A string is stored as its length followed by its
+ * bytes. A path is stored as its vertex count, its first vertex, and the
+ * deltas between successive vertices.
+ */
+namespace snapshot {
+
+/**
+ * Current version of the snapshot format.
+ */
+static const uint32_t VERSION = 2;
+
+/**
+ * Serializes values into a section.
+ */
+class Encoder {
+private:
+
+    /**
+     * The encoded data.
+     */
+    std::string data;
+
+public:
+
+    /**
+     * Appends an unsigned varint.
+     */
+    Encoder &put_varint(uint64_t value);
+
+    /**
+     * Appends a zigzag-encoded signed varint.
+     */
+    Encoder &put_svarint(int64_t value);
+
+    /**
+     * Appends a double as 8 raw bytes.
+     */
+    Encoder &put_double(double value);
+
+    /**
+     * Appends a string.
+     */
+    Encoder &put_string(const std::string &value);
+
+    /**
+     * Appends a path, delta-encoded.
+     */
+    Encoder &put_path(const coord::Path &path);
+
+    /**
+     * Appends a set of paths.
+     */
+    Encoder &put_paths(const coord::Paths &paths);
+
+    /**
+     * Returns the encoded data.
+     */
+    const std::string &get_data() const;
+
+};
+
+/**
+ * Deserializes values from a section. Throws a std::runtime_error when reading
+ * past the end of the section.
+ */
+class Decoder {
+private:
+
+    /**
+     * The data being decoded.
+     */
+    std::string_view data;
+
+    /**
+     * Current read position.
+     */
+    size_t pos;
+
+public:
+
+    /**
+     * Constructs a decoder for the given section data.
+     */
+    explicit Decoder(std::string_view data);
+
+    /**
+     * Reads an unsigned varint.
+     */
+    uint64_t get_varint();
+
+    /**
+     * Reads a zigzag-encoded signed varint.
+     */
+    int64_t get_svarint();
+
+    /**
+     * Reads a double.
+     */
+    double get_double();
+
+    /**
+     * Reads a string.
+     */
+    std::string get_string();
+
+    /**
+     * Reads a delta-encoded path.
+     */
+    coord::Path get_path();
+
+    /**
+     * Reads a set of paths. Throws if any of them is empty.
+     */
+    coord::Paths get_paths();
+
+    /**
+     * Returns whether the whole section has been read.
+     */
+    bool at_end() const;
+
+};
+
+/**
+ * Builds a snapshot from tagged sections.
+ */
+class Writer {
+private:
+
+    /**
+     * Tags of the sections added thus far.
+     */
+    std::vector<uint32_t> tags;
+
+    /**
+     * Data of the sections added thus far.
+     */
+    std::vector<std::string> sections;
+
+public:
+
+    /**
+     * Adds a section with the given tag. Sections with the same tag keep the
+     * order in which they were added.
+     */
+    void add(uint32_t tag, const Encoder &encoder);
+
+    /**
+     * Returns the complete snapshot.
+     */
+    std::string finish() const;
+
+};
+
+/**
+ * Provides access to the sections of a snapshot without decoding them. The
+ * snapshot data is not copied, so it must outlive the reader.
+ */
+class Reader {
+private:
+
+    /**
+     * Tag, offset, and size of every section.
+     */
+    struct Section {
+        uint32_t tag;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    /**
+     * The snapshot data.
+     */
+    std::string_view data;
+
+    /**
+     * The section table.
+     */
+    std::vector<Section> table;
+
+public:
+
+    /**
+     * Validates the header and section table of the given snapshot. Throws a
+     * std::runtime_error if the snapshot is malformed.
+     */
+    explicit Reader(std::string_view data);
+
+    /**
+     * Returns the data of all sections with the given tag, in order.
+     */
+    std::vector<std::string_view> find_all(uint32_t tag) const;
+
+    /**
+     * Returns the data of the only section with the given tag. Throws a
+     * std::runtime_error if there is not exactly one such section.
+     */
+    std::string_view find(uint32_t tag) const;
+
+};
+
+} // namespace snapshot
+} // namespace gerbertools
@@ -90,6 +90,7 @@ Circle::Circle(const std::vector<std::string> &csep, const coord::Format &fmt) {
     auto hole = get_hole(fmt);
     paths.insert(paths.end(), hole.begin(), hole.end());
     plot = std::make_shared<plot::Plot>(paths);
+    plot->finalize();
 
 }
 
@@ -131,6 +132,7 @@ Rectangle::Rectangle(const std::vector<std::string> &csep, const coord::Format &
     auto hole = get_hole(fmt);
     paths.insert(paths.end(), hole.begin(), hole.end());
     plot = std::make_shared<plot::Plot>(paths);
+    plot->finalize();
 
 }
 
@@ -159,6 +161,7 @@ Obround::Obround(const std::vector<std::string> &csep, const coord::Format &fmt)
     auto hole = get_hole(fmt);
     paths.insert(paths.end(), hole.begin(), hole.end());
     plot = std::make_shared<plot::Plot>(paths);
+    plot->finalize();
 
 }
 
@@ -193,6 +196,7 @@ Polygon::Polygon(const std::vector<std::string> &csep, const coord::Format &fmt)
     auto hole = get_hole(fmt);
     paths.insert(paths.end(), hole.begin(), hole.end());
     plot = std::make_shared<plot::Plot>(paths);
+    plot->finalize();
 
 }
 
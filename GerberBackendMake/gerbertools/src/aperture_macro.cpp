@@ -765,6 +765,7 @@ aperture::Ref ApertureMacro::build(const std::vector<std::string>& csep, const c
 
     auto ap_plot = std::make_shared<plot::Plot>();
     ap_plot->draw_paths(plot.get_dark());
+    ap_plot->finalize();
     return std::make_shared<aperture::Custom>(ap_plot);
 }
 
@@ -33,6 +33,13 @@
 namespace gerbertools {
 namespace coord {
 
+/**
+ * Moves the given paths into a new shared, immutable buffer.
+ */
+PathsRef share(Paths &&paths) {
+    return std::make_shared<const Paths>(std::move(paths));
+}
+
 /**
  * Throws an exception if the coordinate format has been used to convert
  * coordinates already.
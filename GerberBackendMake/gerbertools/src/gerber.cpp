@@ -27,6 +27,7 @@
  */
 
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include "gerber.hpp"
@@ -138,6 +139,68 @@ public:
 
 };
 
+/**
+ * Returns whether the given point is strictly inside the given
+ * odd-even-filled polygon.
+ */
+static bool is_inside(const coord::Paths &paths, coord::CPt point) {
+    bool inside = false;
+    for (const auto &path : paths) {
+        auto result = ClipperLib::PointInPolygon(point, path);
+        if (result < 0) {
+            return false;
+        }
+        inside ^= result > 0;
+    }
+    return inside;
+}
+
+/**
+ * Finds a point strictly inside the given odd-even-filled polygon,
+ * preferring the origin. Otherwise, the widest span of a horizontal line
+ * through the middle of one of the paths is used. Returns false if no such
+ * point was found, i.e. if the polygon has no area.
+ */
+static bool find_dark_point(const coord::Paths &paths, coord::CPt &point) {
+    point = {0, 0};
+    if (is_inside(paths, point)) {
+        return true;
+    }
+    for (const auto &path : paths) {
+        if (path.empty()) {
+            continue;
+        }
+        auto bottom = path.front().Y, top = path.front().Y;
+        for (const auto &vertex : path) {
+            bottom = std::min(bottom, vertex.Y);
+            top = std::max(top, vertex.Y);
+        }
+        auto y = bottom + (top - bottom) / 2;
+        std::vector<double> crossings;
+        for (const auto &crossed : paths) {
+            for (size_t i = 0; i < crossed.size(); i++) {
+                const auto &a = crossed[i];
+                const auto &b = crossed[(i + 1) % crossed.size()];
+                if ((a.Y <= y) != (b.Y <= y)) {
+                    crossings.push_back(a.X + (double)(y - a.Y) * (b.X - a.X) / (b.Y - a.Y));
+                }
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        double widest = 0.0;
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            if (crossings[i + 1] - crossings[i] > widest) {
+                widest = crossings[i + 1] - crossings[i];
+                point = {(coord::CInt)std::round((crossings[i] + crossings[i + 1]) / 2), y};
+            }
+        }
+        if (widest > 0.0 && is_inside(paths, point)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * Render the current aperture to the current plot, taking into
  * consideration all configured aperture transformations.
@@ -153,6 +216,7 @@ void Gerber::draw_aperture() {
         ap_mirror_x, ap_mirror_y,
         ap_rotate, ap_scale
     );
+    record_net_object(pos, true);
 }
 
 /**
@@ -264,6 +328,7 @@ void Gerber::interpolate(coord::CPt dest, coord::CPt center) {
 
     // Add the path to the plot.
     plot_stack.back()->draw_paths(paths, polarity);
+    record_net_object(dest, false);
 
 }
 
@@ -297,9 +362,100 @@ void Gerber::commit_region() {
 }
 
 /**
- * Handles a Gerber command. Returns true to continue, false if the command
- * marks the end, or throws a runtime error if the command is not
- * recognized.
+ * Records an object drawn at the given coordinate in net_objects, if it is
+ * dark, drawn onto the topmost plot, and tagged with a net name. For
+ * flashes, the coordinate is the flash position, but a point that the
+ * current aperture actually covers is recorded.
+ */
+void Gerber::record_net_object(coord::CPt coordinate, bool flash) {
+    if (!polarity || plot_stack.size() != 1) {
+        return;
+    }
+    auto nets = object_attributes.find(".N");
+    if (nets == object_attributes.end()) {
+        return;
+    }
+
+    // The position of a flash need not be on its copper, for example for
+    // donuts or macros with offset primitives, so look for a point of the
+    // aperture that is dark, and transform it like draw_plot() does. Flashes
+    // without any copper are not recorded.
+    if (flash) {
+        coord::CPt dark;
+        if (!find_dark_point(aperture->get_plot().get_dark(), dark)) {
+            return;
+        }
+        double scale_x = ap_mirror_x ? -ap_scale : ap_scale;
+        double scale_y = ap_mirror_y ? -ap_scale : ap_scale;
+        double si = std::sin(ap_rotate);
+        double co = std::cos(ap_rotate);
+        coordinate.X += (coord::CInt)std::round(dark.X * scale_x * co - dark.Y * scale_y * si);
+        coordinate.Y += (coord::CInt)std::round(dark.X * scale_x * si + dark.Y * scale_y * co);
+    }
+
+    std::string reference, pin;
+    auto pad = object_attributes.find(".P");
+    if (pad != object_attributes.end() && pad->second.size() >= 2) {
+        reference = pad->second.at(0);
+        pin = pad->second.at(1);
+    }
+    for (const auto &net : nets->second) {
+
+        // An empty name marks objects that are explicitly not connected; some
+        // CAM tools use N/C for that instead.
+        if (net.empty() || net == "N/C") {
+            continue;
+        }
+        net_objects.push_back({net, reference, pin, coordinate, flash});
+    }
+}
+
+/**
+ * Handles an X2 attribute command (TF, TA, TO, or TD).
+ */
+void Gerber::set_attribute(const std::string &cmd) {
+
+    // Split the attribute name and values.
+    std::vector<std::string> values;
+    size_t start = 2;
+    while (true) {
+        auto end = cmd.find(',', start);
+        values.push_back(cmd.substr(start, end - start));
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    auto name = values.front();
+    values.erase(values.begin());
+
+    // TD without a name deletes all aperture and object attributes; with a
+    // name, only that attribute.
+    if (cmd.rfind("TD", 0) == 0) {
+        if (name.empty()) {
+            aperture_attributes.clear();
+            object_attributes.clear();
+        } else {
+            aperture_attributes.erase(name);
+            object_attributes.erase(name);
+        }
+        return;
+    }
+    if (name.empty()) {
+        throw std::runtime_error("attribute without name: " + cmd);
+    }
+    if (cmd.rfind("TF", 0) == 0) {
+        file_attributes[name] = std::move(values);
+    } else if (cmd.rfind("TA", 0) == 0) {
+        aperture_attributes[name] = std::move(values);
+    } else {
+        object_attributes[name] = std::move(values);
+    }
+}
+
+/**
+ * Handles a Gerber command. Returns true to continue, or false if the
+ * command marks the end. Commands that are not recognized are ignored.
  */
 bool Gerber::command(const std::string &cmd, bool is_attrib) {
     if (am_builder) {
@@ -387,6 +543,7 @@ bool Gerber::command(const std::string &cmd, bool is_attrib) {
                 if (plot_stack.size() <= 1) {
                     throw std::runtime_error("unmatched aperture block close command");
                 }
+                plot_stack.back()->finalize();
                 plot_stack.pop_back();
             } else {
                 if (cmd.size() < 4 || cmd.at(2) != 'D') {
@@ -403,13 +560,12 @@ bool Gerber::command(const std::string &cmd, bool is_attrib) {
             return true;
         }
 
-        // Unsupported attributes that can be ignored.
-        if (cmd.rfind("TF", 0) == 0) {
-            return true;
-        }
-
-        // Unsupported attributes that can be ignored.
-        if (cmd.rfind("TA", 0) == 0) {
+        // X2 attributes.
+        if (
+            cmd.rfind("TF", 0) == 0 || cmd.rfind("TA", 0) == 0 ||
+            cmd.rfind("TO", 0) == 0 || cmd.rfind("TD", 0) == 0
+        ) {
+            set_attribute(cmd);
             return true;
         }
 
@@ -600,7 +756,11 @@ bool Gerber::command(const std::string &cmd, bool is_attrib) {
         }
 
     }
-    /*throw std::runtime_error("unknown command: " + cmd);*/
+
+    // Unknown commands are ignored rather than rejected, as plenty of CAM
+    // tools emit vendor-specific or deprecated commands that don't affect
+    // the image.
+    return true;
 }
 
 /**
@@ -663,6 +823,7 @@ Gerber::Gerber(std::istream &s) {
     if (region_mode) {
         throw std::runtime_error("unterminated region block");
     }
+    plot_stack.back()->finalize();
 }
 
 /**
@@ -672,6 +833,23 @@ const coord::Paths &Gerber::get_paths() const {
     return plot_stack.back()->get_dark();
 }
 
+/**
+ * Returns the file attributes set via TF commands.
+ */
+const Attributes &Gerber::get_file_attributes() const {
+    return file_attributes;
+}
+
+/**
+ * Returns the flashes and draws that were tagged with a net name via the
+ * X2 .N object attribute, in file order. Regions, objects with clear
+ * polarity and objects inside block apertures are not included, and
+ * objects on more than one net are listed once for each net.
+ */
+const std::vector<NetObject> &Gerber::get_net_objects() const {
+    return net_objects;
+}
+
 /**
  * Attempts to interpret the Gerber file data as the board outline and/or
  * milling data, returning polygons that follow the center of closed loops
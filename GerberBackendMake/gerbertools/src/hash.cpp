@@ -0,0 +1,240 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a fast, non-cryptographic content hash (XXH64), used to key caches
+ * on file contents and as an ETag for rendered outputs.
+ */
+
+#include "hash.hpp"
+#include <cstring>
+
+namespace gerbertools {
+namespace hash {
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+/**
+ * Rotates the given value left by the given number of bits.
+ */
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * Reads a little-endian 64-bit value.
+ */
+static uint64_t read64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/**
+ * Reads a little-endian 32-bit value.
+ */
+static uint64_t read32(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 3; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/**
+ * Mixes a 64-bit input into an accumulator.
+ */
+static uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+/**
+ * Merges an accumulator into the hash after the bulk loop.
+ */
+static uint64_t merge_round(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+/**
+ * Computes the XXH64 hash of the given data with the given seed.
+ */
+uint64_t xxh64(const void *data, size_t size, uint64_t seed) {
+    auto p = static_cast<const uint8_t*>(data);
+    auto end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        auto limit = end - 32;
+        do {
+            v1 = round(v1, read64(p)); p += 8;
+            v2 = round(v2, read64(p)); p += 8;
+            v3 = round(v3, read64(p)); p += 8;
+            v4 = round(v4, read64(p)); p += 8;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+
+    h += static_cast<uint64_t>(size);
+
+    while (p + 8 <= end) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= read32(p) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * Computes the XXH64 hash of the given string with the given seed.
+ */
+uint64_t xxh64(std::string_view data, uint64_t seed) {
+    return xxh64(data.data(), data.size(), seed);
+}
+
+/**
+ * Constructs a hasher with the given seed.
+ */
+Hasher::Hasher(uint64_t seed) : state(seed) {
+}
+
+/**
+ * Adds the given string to the hash.
+ */
+Hasher &Hasher::add(std::string_view data) {
+    state = xxh64(data, state);
+    return *this;
+}
+
+/**
+ * Adds the given integer to the hash.
+ */
+Hasher &Hasher::add(uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    state = xxh64(bytes, sizeof(bytes), state);
+    return *this;
+}
+
+/**
+ * Adds the given floating point value to the hash.
+ */
+Hasher &Hasher::add(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return add(bits);
+}
+
+/**
+ * Returns the hash of everything added so far.
+ */
+uint64_t Hasher::digest() const {
+    return state;
+}
+
+/**
+ * Hashes a map of file contents by role, for any string-like content type.
+ */
+template <typename T>
+static uint64_t hash_file_map(const std::map<std::string, std::vector<T>> &files) {
+    Hasher hasher;
+    hasher.add(static_cast<uint64_t>(files.size()));
+    for (const auto &file : files) {
+        hasher.add(file.first);
+        hasher.add(static_cast<uint64_t>(file.second.size()));
+        for (const auto &contents : file.second) {
+            hasher.add(std::string_view(contents));
+        }
+    }
+    return hasher.digest();
+}
+
+/**
+ * Hashes a map of file contents by role, as passed to
+ * pcb::CircuitBoard::LoadPCB().
+ */
+uint64_t hash_files(const std::map<std::string, std::vector<std::string>> &files) {
+    return hash_file_map(files);
+}
+
+/**
+ * As above, for file contents held as views. Gives the same hash as the
+ * equivalent map of strings.
+ */
+uint64_t hash_files(const std::map<std::string, std::vector<std::string_view>> &files) {
+    return hash_file_map(files);
+}
+
+/**
+ * Formats a hash as 16 lowercase hexadecimal digits, suitable for use as an
+ * ETag.
+ */
+std::string to_hex(uint64_t hash) {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string result(16, '0');
+    for (int i = 15; i >= 0; i--) {
+        result[i] = DIGITS[hash & 0xF];
+        hash >>= 4;
+    }
+    return result;
+}
+
+} // namespace hash
+} // namespace gerbertools
@@ -0,0 +1,208 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a streaming reader for IPC-D-356 netlists.
+ */
+
+#include <map>
+#include <unordered_map>
+#include <sstream>
+#include <stdexcept>
+#include "ipc356.hpp"
+
+namespace gerbertools {
+namespace ipc356 {
+
+/**
+ * Returns the given string without leading and trailing whitespace.
+ */
+static std::string trim(const std::string &s) {
+    auto first = s.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+        return "";
+    }
+    auto last = s.find_last_not_of(" \t");
+    return s.substr(first, last - first + 1);
+}
+
+/**
+ * Returns the fixed-width field of the given record at the given zero-based
+ * column, without surrounding whitespace.
+ */
+static std::string field(const std::string &line, size_t column, size_t width) {
+    if (column >= line.size()) {
+        return "";
+    }
+    return trim(line.substr(column, width));
+}
+
+/**
+ * Parses a signed decimal number from the fixed-width field of the given
+ * record at the given zero-based column.
+ */
+static long parse_number(const std::string &line, size_t column, size_t width) {
+    auto s = field(line, column, width);
+    size_t i = 0;
+    bool negative = false;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+        negative = s[i] == '-';
+        i++;
+    }
+    if (i == s.size()) {
+        throw std::runtime_error("missing number in IPC-D-356 record: " + line);
+    }
+    long value = 0;
+    for (; i < s.size(); i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            throw std::runtime_error("invalid number in IPC-D-356 record: " + line);
+        }
+        value = value * 10 + (s[i] - '0');
+    }
+    return negative ? -value : value;
+}
+
+/**
+ * Reads the test point records of an IPC-D-356 netlist from the given stream
+ * one by one, calling fn for each. The file is processed line by line and
+ * never held in memory as a whole. Test points that are not connected to any
+ * net (N/C) and unplated holes (U in column 38) are skipped.
+ */
+void read(std::istream &stream, const std::function<void(const TestPoint&)> &fn) {
+
+    // Coordinates are in units of 0.0001 inch, unless metric units are
+    // selected, in which case they are in micrometers.
+    double unit_mm = 0.00254;
+
+    // Net names longer than 14 characters are replaced by NNAMEx aliases in
+    // the test records.
+    std::map<std::string, std::string> aliases;
+
+    std::string line;
+    TestPoint point;
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == 'C') {
+            continue;
+        }
+
+        // Handle parameter records.
+        if (line[0] == 'P') {
+            std::istringstream ss(line.substr(1));
+            std::string key, value;
+            ss >> key;
+            std::getline(ss, value);
+            value = trim(value);
+            if (key == "UNITS") {
+                if (value == "SI" || value == "CUST 1") {
+                    unit_mm = 0.001;
+                } else if (value == "CUST 0" || value == "CUST 2" || value.find("INCH") != std::string::npos) {
+                    unit_mm = 0.00254;
+                } else {
+                    throw std::runtime_error("unsupported IPC-D-356 units: " + value);
+                }
+            } else if (key.compare(0, 5, "NNAME") == 0) {
+                aliases[key] = value;
+            }
+            continue;
+        }
+
+        // Handle the end of the file.
+        if (line.compare(0, 3, "999") == 0) {
+            break;
+        }
+
+        // Only through-hole and surface mount test records describe points
+        // that must be connected; everything else is skipped.
+        auto type = line.substr(0, 3);
+        if (type != "317" && type != "327") {
+            continue;
+        }
+        if (line.size() < 57 || line[41] != 'X' || line[49] != 'Y') {
+            throw std::runtime_error("malformed IPC-D-356 test record: " + line);
+        }
+        point.net = field(line, 3, 14);
+        auto alias = aliases.find(point.net);
+        if (alias != aliases.end()) {
+            point.net = alias->second;
+        }
+        if (point.net.empty() || point.net == "N/C") {
+            continue;
+        }
+
+        // Unplated holes cannot connect anything.
+        if (line[37] == 'U') {
+            continue;
+        }
+        point.reference = field(line, 20, 6);
+        point.pin = field(line, 27, 4);
+        int access = 0;
+        if (line[38] == 'A') {
+            access = (int)parse_number(line, 39, 2);
+        }
+        point.layer = (access <= 1) ? -1 : -access;
+        point.coordinate.X = coord::Format::from_mm(parse_number(line, 42, 7) * unit_mm);
+        point.coordinate.Y = coord::Format::from_mm(parse_number(line, 50, 7) * unit_mm);
+        point.through_hole = type == "317";
+        fn(point);
+    }
+}
+
+/**
+ * Reads the test points of an IPC-D-356 netlist from the given stream and adds
+ * them to the given builder as connection points. The points are passed to
+ * NetlistBuilder::add_connections() in batches of the given size, such that
+ * only one batch is buffered at a time. Returns the number of points added.
+ */
+size_t read_connections(std::istream &stream, netlist::NetlistBuilder &builder, size_t batch_size) {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> name_ids;
+    std::vector<netlist::ConnectionRecord> records;
+    size_t count = 0;
+    auto flush = [&]() {
+        builder.add_connections(names, records);
+        count += records.size();
+        names.clear();
+        name_ids.clear();
+        records.clear();
+    };
+    read(stream, [&](const TestPoint &point) {
+        auto it = name_ids.find(point.net);
+        if (it == name_ids.end()) {
+            it = name_ids.emplace(point.net, (uint32_t)names.size()).first;
+            names.push_back(point.net);
+        }
+        records.push_back({point.coordinate, point.layer, it->second});
+        if (records.size() >= batch_size) {
+            flush();
+        }
+    });
+    flush();
+    return count;
+}
+
+} // namespace ipc356
+} // namespace gerbertools
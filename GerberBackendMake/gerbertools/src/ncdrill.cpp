@@ -29,6 +29,7 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <sstream>
+#include <map>
 #include "ncdrill.hpp"
 #include "path.hpp"
 
@@ -70,7 +71,7 @@ Via::Via(
  * Returns the path that the drill took to make the via. For most vias this
  * will be a single point, but plated slots are possible this way.
  */
-coord::Path Via::get_path() const {
+const coord::Path &Via::get_path() const {
     return path;
 }
 
@@ -82,18 +83,115 @@ coord::CInt Via::get_finished_hole_size() const {
 }
 
 /**
- * Commits the path in the path field to the plots and to vias based on the
- * current tool.
+ * Constructs a new hole.
+ */
+Hole::Hole(
+    coord::CPt start,
+    coord::CPt end,
+    coord::CInt diameter,
+    bool plated
+) :
+    start(start),
+    end(end),
+    diameter(diameter),
+    plated(plated)
+{}
+
+/**
+ * Returns the center of the hole, or the start of the slot segment.
+ */
+coord::CPt Hole::get_start() const {
+    return start;
+}
+
+/**
+ * Returns the end of the slot segment. Equal to get_start() for round
+ * holes.
+ */
+coord::CPt Hole::get_end() const {
+    return end;
+}
+
+/**
+ * Returns the diameter of the tool that made the hole.
+ */
+coord::CInt Hole::get_diameter() const {
+    return diameter;
+}
+
+/**
+ * Returns whether the hole is plated.
+ */
+bool Hole::is_plated() const {
+    return plated;
+}
+
+/**
+ * Returns whether this is a slot segment rather than a round hole.
+ */
+bool Hole::is_slot() const {
+    return start != end;
+}
+
+/**
+ * Polygonizes the selected holes in the given table, optionally expanding
+ * their diameter by twice the given amount. The result is the positively-wound
+ * union of all the holes. Holes of the same (expanded) diameter are offset in a
+ * single pass, using the arc tolerance and miter limit of the given format.
+ */
+coord::Paths render_holes(
+    const HoleTable &holes,
+    bool plated,
+    bool unplated,
+    coord::CInt expansion,
+    const coord::Format &fmt
+) {
+
+    // Group the holes by diameter, such that each group can be handed to
+    // Clipper as one set of open paths. Round holes are degenerate
+    // single-point paths, which Clipper renders as circles.
+    std::map<coord::CInt, coord::Paths> by_diameter;
+    for (const auto &hole : holes) {
+        if (hole.is_plated() ? !plated : !unplated) {
+            continue;
+        }
+        auto &paths = by_diameter[hole.get_diameter() + 2 * expansion];
+        if (hole.is_slot()) {
+            paths.push_back({hole.get_start(), hole.get_end()});
+        } else {
+            paths.push_back({hole.get_start()});
+        }
+    }
+
+    // Offset each group and merge the results.
+    coord::Paths result;
+    for (const auto &it : by_diameter) {
+        auto rendered = path::render(it.second, it.first, false, fmt.build_clipper_offset());
+        result.insert(result.end(), rendered.begin(), rendered.end());
+    }
+    if (by_diameter.size() > 1) {
+        ClipperLib::SimplifyPolygons(result, ClipperLib::pftNonZero);
+    }
+    return result;
+}
+
+/**
+ * Commits the path in the path field to the hole table and to vias based
+ * on the current tool.
  */
 void NCDrill::commit_path() {
     if (!tool) {
         throw std::runtime_error("tool use before any tool is selected");
     }
+    if (path.size() == 1) {
+        holes.emplace_back(path.front(), path.front(), tool->get_diameter(), tool->is_plated());
+    } else {
+        for (size_t i = 1; i < path.size(); i++) {
+            holes.emplace_back(path.at(i - 1), path.at(i), tool->get_diameter(), tool->is_plated());
+        }
+    }
     if (tool->is_plated()) {
-        plot_pth.draw_paths(path::render({{path}}, tool->get_diameter(), false, fmt.build_clipper_offset()));
         vias.emplace_back(path, tool->get_diameter());
-    } else {
-        plot_npth.draw_paths(path::render({{path}}, tool->get_diameter(), false, fmt.build_clipper_offset()));
     }
     path.clear();
 }
@@ -527,30 +625,21 @@ NCDrill::NCDrill(std::istream &s, bool default_plated) {
 
 /**
  * Returns the cutout paths for this NC drill file as negatively-wound
- * polygons.
+ * polygons. These are rendered from the hole table on every call.
  */
 coord::Paths NCDrill::get_paths(bool plated, bool unplated) const {
-    coord::Paths paths;
-    if (plated) {
-        if (unplated) {
-            ClipperLib::Clipper c;
-            c.AddPaths(plot_pth.get_dark(), ClipperLib::ptSubject, true);
-            c.AddPaths(plot_npth.get_dark(), ClipperLib::ptSubject, true);
-            c.Execute(ClipperLib::ctUnion, paths, ClipperLib::pftPositive);
-        } else {
-            paths = plot_pth.get_dark();
-        }
-    } else {
-        if (unplated) {
-            paths = plot_npth.get_dark();
-        } else {
-            return {};
-        }
-    }
+    auto paths = render_holes(holes, plated, unplated, 0, fmt);
     ClipperLib::ReversePaths(paths);
     return paths;
 }
 
+/**
+ * Returns all holes in this NC drill file as primitives.
+ */
+const HoleTable &NCDrill::get_holes() const {
+    return holes;
+}
+
 /**
  * Returns the center coordinates of all plated holes.
  */
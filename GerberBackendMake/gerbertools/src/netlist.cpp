@@ -31,9 +31,10 @@
 #include <sstream>
 #include <cmath>
 #include <limits>
+#include <iterator>
 #include "netlist.hpp"
 #include "clipper.hpp"
-#include "path.hpp"
+#include "parallel.hpp"
 
 namespace gerbertools {
 namespace netlist {
@@ -80,7 +81,7 @@ coord::CPt Via::get_coordinate() const {
 /**
  * Returns the entire milled path for the via.
  */
-coord::Path Via::get_path() const {
+const coord::Path &Via::get_path() const {
     return path;
 }
 
@@ -122,6 +123,125 @@ size_t Via::get_upper_layer(size_t num_layers) const {
     return resolve_layer_index(upper_layer, num_layers);
 }
 
+/**
+ * Constructs an empty index.
+ */
+SlabIndex::SlabIndex() : bottom(0), top(-1), slab_height(1), offsets({0, 0}) {
+}
+
+/**
+ * Constructs an index for items with the given Y ranges, using the given
+ * number of slabs.
+ */
+SlabIndex::SlabIndex(
+    const std::vector<std::pair<coord::CInt, coord::CInt>> &ranges,
+    size_t num_slabs
+) : SlabIndex() {
+    if (ranges.empty()) {
+        return;
+    }
+    bottom = ranges.front().first;
+    top = ranges.front().second;
+    for (const auto &range : ranges) {
+        bottom = std::min(bottom, range.first);
+        top = std::max(top, range.second);
+    }
+    num_slabs = std::max<size_t>(num_slabs, 1);
+    slab_height = (top - bottom) / (coord::CInt)num_slabs + 1;
+
+    // Count the items per slab, then fill them in.
+    offsets.assign(num_slabs + 1, 0);
+    for (const auto &range : ranges) {
+        for (auto slab = (range.first - bottom) / slab_height; slab <= (range.second - bottom) / slab_height; slab++) {
+            offsets.at(slab + 1)++;
+        }
+    }
+    for (size_t slab = 0; slab < num_slabs; slab++) {
+        offsets.at(slab + 1) += offsets.at(slab);
+    }
+    items.resize(offsets.back());
+    auto next = offsets;
+    for (size_t item = 0; item < ranges.size(); item++) {
+        const auto &range = ranges.at(item);
+        for (auto slab = (range.first - bottom) / slab_height; slab <= (range.second - bottom) / slab_height; slab++) {
+            items.at(next.at(slab)++) = (uint32_t)item;
+        }
+    }
+}
+
+/**
+ * Returns the range of item indices that may contain the given Y
+ * coordinate. All items that do are in the range.
+ */
+std::pair<const uint32_t*, const uint32_t*> SlabIndex::find(coord::CInt y) const {
+    if (y < bottom || y > top) {
+        return {nullptr, nullptr};
+    }
+    auto slab = (y - bottom) / slab_height;
+    return {items.data() + offsets.at(slab), items.data() + offsets.at(slab + 1)};
+}
+
+/**
+ * Returns the bounding box of the given path.
+ */
+static coord::CRect path_bounds(const coord::Path &path) {
+    coord::CRect box;
+    box.left = box.right = path.at(0).X;
+    box.bottom = box.top = path.at(0).Y;
+    for (const auto &coord : path) {
+        box.left = std::min(box.left, coord.X);
+        box.bottom = std::min(box.bottom, coord.Y);
+        box.right = std::max(box.right, coord.X);
+        box.top = std::max(box.top, coord.Y);
+    }
+    return box;
+}
+
+/**
+ * Builds a slab index for the edges of the given closed path. Edge i runs
+ * from vertex i to the next.
+ */
+static SlabIndex index_edges(const coord::Path &path) {
+    std::vector<std::pair<coord::CInt, coord::CInt>> ranges;
+    ranges.reserve(path.size());
+    for (size_t i = 0; i < path.size(); i++) {
+        auto a = path.at(i).Y;
+        auto b = path.at((i + 1) % path.size()).Y;
+        ranges.emplace_back(std::min(a, b), std::max(a, b));
+    }
+    return SlabIndex(ranges, path.size() / 4);
+}
+
+/**
+ * Determines whether the given point is inside the given closed path, with
+ * the same result as ClipperLib::PointInPolygon(): 0 if outside, 1 if inside,
+ * or -1 if on the boundary. Only the edges that the slab index returns for
+ * the point's Y coordinate are visited; the edges that do not span it cannot
+ * affect the result.
+ */
+static int locate_point(coord::CPt pt, const coord::Path &path, const SlabIndex &edges) {
+    if (path.size() < 3) return 0;
+    int result = 0;
+    auto range = edges.find(pt.Y);
+    for (auto it = range.first; it != range.second; ++it) {
+        const auto &ip = path[*it];
+        const auto &ip_next = path[(*it + 1) % path.size()];
+        if (ip_next.Y == pt.Y) {
+            if ((ip_next.X == pt.X) || (ip.Y == pt.Y && ((ip_next.X > pt.X) == (ip.X < pt.X)))) return -1;
+        }
+        if ((ip.Y < pt.Y) != (ip_next.Y < pt.Y)) {
+            if (ip.X >= pt.X && ip_next.X > pt.X) {
+                result = 1 - result;
+            } else if (ip.X >= pt.X || ip_next.X > pt.X) {
+                double d = (double)(ip.X - pt.X) * (ip_next.Y - pt.Y) - (double)(ip_next.X - pt.X) * (ip.Y - pt.Y);
+                if (!d) return -1;
+                if ((d > 0) == (ip_next.Y > ip.Y)) result = 1 - result;
+            }
+        }
+    }
+    return result;
+}
+
 /**
  * Constructs a new copper shape.
  */
@@ -132,16 +252,17 @@ Shape::Shape(
 ) :
     outline(outline),
     holes(holes),
+    bounding_box(path_bounds(outline)),
+    outline_edges(index_edges(outline)),
     layer(layer)
 {
-    bounding_box.left = bounding_box.right = outline.at(0).X;
-    bounding_box.bottom = bounding_box.top = outline.at(0).Y;
-    for (const auto &coord : outline) {
-        bounding_box.left = std::min(bounding_box.left, coord.X);
-        bounding_box.bottom = std::min(bounding_box.bottom, coord.Y);
-        bounding_box.right = std::max(bounding_box.right, coord.X);
-        bounding_box.top = std::max(bounding_box.top, coord.Y);
+    std::vector<std::pair<coord::CInt, coord::CInt>> hole_ranges;
+    for (const auto &hole : holes) {
+        hole_boxes.push_back(path_bounds(hole));
+        hole_ranges.emplace_back(hole_boxes.back().bottom, hole_boxes.back().top);
+        hole_edges.push_back(index_edges(hole));
     }
+    hole_slabs = SlabIndex(hole_ranges, holes.size() / 2);
 }
 
 /**
@@ -158,6 +279,13 @@ const coord::Paths &Shape::get_holes() const {
     return holes;
 }
 
+/**
+ * Returns the axis-aligned bounding box of the shape.
+ */
+const coord::CRect &Shape::get_bounding_box() const {
+    return bounding_box;
+}
+
 /**
  * Returns the layer index for this shape. Layer indices are from 0 to N-1
  * for bottom to top.
@@ -174,36 +302,60 @@ bool Shape::contains(coord::CPt point) const {
     if (point.X > bounding_box.right) return false;
     if (point.Y < bounding_box.bottom) return false;
     if (point.Y > bounding_box.top) return false;
-    if (ClipperLib::PointInPolygon(point, outline) == 0) return false;
-    for (const auto &hole : holes) {
-        if (ClipperLib::PointInPolygon(point, hole) == 1) return false;
+    if (locate_point(point, outline, outline_edges) == 0) return false;
+    auto range = hole_slabs.find(point.Y);
+    for (auto it = range.first; it != range.second; ++it) {
+        const auto &box = hole_boxes[*it];
+        if (point.X < box.left || point.X > box.right) continue;
+        if (point.Y < box.bottom || point.Y > box.top) continue;
+        if (locate_point(point, holes[*it], hole_edges[*it]) == 1) return false;
     }
     return true;
 }
 
 /**
- * Constructs a physical net from the given initial shape.
+ * Determines for each of the given points whether it is inside the shape.
  */
-PhysicalNet::PhysicalNet(const ShapeRef &shape) : shapes({shape}) {
+std::vector<bool> Shape::contains(const std::vector<coord::CPt> &points) const {
+    std::vector<bool> result(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        result[i] = contains(points[i]);
+    }
+    return result;
 }
 
 /**
- * Adds a via to this net.
+ * Returns the number of nets.
  */
-void PhysicalNet::add_via(const ViaRef &via) {
-    vias.push_back(via);
+size_t NetArena::get_net_count() const {
+    return net_shapes.empty() ? 0 : net_shapes.size() - 1;
 }
 
 /**
- * Moves the objects from the given net into this net in order to merge
- * them.
+ * Returns the shapes of the given net.
  */
-void PhysicalNet::merge_with(const PhysicalNetRef &net) {
-    shapes.splice(shapes.end(), net->shapes);
-    vias.splice(vias.end(), net->vias);
-    for (const auto &logical_net : net->logical_nets) {
-        logical_nets.insert(logical_net);
-    }
+Span<Shape> NetArena::get_shapes(NetId net) const {
+    return {shapes.data() + net_shapes.at(net), shapes.data() + net_shapes.at(net + 1)};
+}
+
+/**
+ * Returns the vias of the given net.
+ */
+Span<Via> NetArena::get_vias(NetId net) const {
+    return {vias.data() + net_vias.at(net), vias.data() + net_vias.at(net + 1)};
+}
+
+/**
+ * Constructs a view of the net with the given id in the given arena.
+ */
+PhysicalNet::PhysicalNet(std::shared_ptr<const NetArena> arena, NetId id) : arena(std::move(arena)), id(id) {
+}
+
+/**
+ * Returns the id of this net within the arena of its netlist.
+ */
+NetId PhysicalNet::get_id() const {
+    return id;
 }
 
 /**
@@ -211,9 +363,9 @@ void PhysicalNet::merge_with(const PhysicalNetRef &net) {
  * net.
  */
 bool PhysicalNet::contains(coord::CPt point, size_t layer) const {
-    for (const auto &shape : shapes) {
-        if (shape->get_layer() == layer) {
-            if (shape->contains(point)) {
+    for (const auto &shape : get_shapes()) {
+        if (shape.get_layer() == layer) {
+            if (shape.contains(point)) {
                 return true;
             }
         }
@@ -229,17 +381,17 @@ void PhysicalNet::assign_logical(const LogicalNetRef &logical_net) {
 }
 
 /**
- * Returns the list of copper shapes connected to this net.
+ * Returns the copper shapes connected to this net.
  */
-const std::list<ShapeRef> &PhysicalNet::get_shapes() const {
-    return shapes;
+Span<Shape> PhysicalNet::get_shapes() const {
+    return arena->get_shapes(id);
 }
 
 /**
- * Returns the list of vias connected to this net.
+ * Returns the vias connected to this net.
  */
-const std::list<ViaRef> &PhysicalNet::get_vias() {
-    return vias;
+Span<Via> PhysicalNet::get_vias() const {
+    return arena->get_vias(id);
 }
 
 /**
@@ -262,11 +414,10 @@ const std::string &LogicalNet::get_name() const {
 }
 
 /**
- * Assigns physical nets from both physical netlists to this logical net.
+ * Assigns a physical net to this logical net.
  */
-void LogicalNet::assign_physical(const PhysicalNetRef &connected, const PhysicalNetRef &clearance) {
+void LogicalNet::assign_physical(const PhysicalNetRef &connected) {
     connected_nets.insert(connected);
-    clearance_nets.insert(clearance);
 }
 
 /**
@@ -278,25 +429,53 @@ const PhysicalNets &LogicalNet::get_connected_nets() const {
 }
 
 /**
- * Returns the set of physical nets from the clearance netlist associated
- * with this logical net.
+ * Edge length of the cells of the spatial shape index.
+ */
+static const coord::CInt INDEX_CELL_SIZE = coord::Format::from_mm(2.0);
+
+/**
+ * Returns the index of the grid cell containing the given coordinate along
+ * one axis, for cells of the given size.
+ */
+static int64_t index_cell(coord::CInt c, coord::CInt size = INDEX_CELL_SIZE) {
+    return (c >= 0) ? (c / size) : (-((-c - 1) / size) - 1);
+}
+
+/**
+ * Returns the key of the spatial index cell with the given cell indices.
  */
-const PhysicalNets &LogicalNet::get_clearance_nets() const {
-    return clearance_nets;
+static uint64_t index_key(int64_t x, int64_t y) {
+    return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y;
 }
 
 /**
  * Creates a new physical netlist.
  */
-PhysicalNetlist::PhysicalNetlist() : vias_added(false) {
+PhysicalNetlist::PhysicalNetlist() : vias_added(false), finished(false) {
 }
 
 /**
  * Adds a copper shape to the netlist. The netlist is updated accordingly.
  */
-void PhysicalNetlist::register_shape(const ShapeRef &shape) {
+void PhysicalNetlist::register_shape(Shape shape) {
     if (vias_added) throw std::runtime_error("cannot add shapes after the first via has been added");
-    nets.push_back(std::make_shared<PhysicalNet>(shape));
+    if (shapes.size() >= UINT32_MAX) throw std::runtime_error("too many shapes in netlist");
+    auto shape_index = shapes.size();
+    auto layer = shape.get_layer();
+    auto box = shape.get_bounding_box();
+    shapes.push_back(std::move(shape));
+    sets.push_back({shape_index, 1, shape_index, shape_index, shape_index, NONE, NONE, NONE});
+
+    // Add the shape to the spatial index.
+    if (index.size() <= layer) {
+        index.resize(layer + 1);
+    }
+    auto &grid = index.at(layer);
+    for (auto x = index_cell(box.left); x <= index_cell(box.right); x++) {
+        for (auto y = index_cell(box.bottom); y <= index_cell(box.top); y++) {
+            grid[index_key(x, y)].push_back((ShapeId)shape_index);
+        }
+    }
 }
 
 /**
@@ -316,7 +495,7 @@ static void nodes_to_physical_netlist(const ClipperLib::PolyNodes &nodes, Physic
             holes.push_back(hole->Contour);
             nodes_to_physical_netlist(hole->Childs, pnl, layer);
         }
-        pnl.register_shape(std::make_shared<Shape>(node->Contour, holes, layer));
+        pnl.register_shape(Shape(node->Contour, holes, layer));
     }
 }
 
@@ -338,53 +517,400 @@ void PhysicalNetlist::register_paths(const coord::Paths &paths, size_t layer) {
  * true if successful, or false if any of the specified layers do not have
  * copper at the center point of the via.
  */
-bool PhysicalNetlist::register_via(const ViaRef &via, size_t num_layers) {
-    size_t lower_layer = via->get_lower_layer(num_layers);
-    size_t upper_layer = via->get_upper_layer(num_layers);
+bool PhysicalNetlist::register_via(const Via &via, size_t num_layers) {
+    if (finished) throw std::runtime_error("cannot add vias after the netlist has been finished");
+    size_t lower_layer = via.get_lower_layer(num_layers);
+    size_t upper_layer = via.get_upper_layer(num_layers);
     if (lower_layer >= upper_layer) {
         throw std::runtime_error("via has null layer range or only includes one layer");
     }
     vias_added = true;
-    bool ok = true;
-    PhysicalNetRef target = {};
+    via_records.push_back({via, lower_layer, upper_layer, via_hits.size()});
     for (size_t layer = lower_layer; layer <= upper_layer; layer++) {
-        auto source = find_net(via->get_coordinate(), layer);
-        if (!source) {
+        via_hits.push_back(find_shape(via.get_coordinate(), layer));
+    }
+    return connect_via(via_records.size() - 1);
+}
+
+/**
+ * Merges the shapes hit by the via of the given record and adds the via
+ * to the resulting set. Returns false if the via misses copper on any
+ * of its layers.
+ */
+bool PhysicalNetlist::connect_via(size_t record) {
+    const auto &via_record = via_records.at(record);
+    bool ok = true;
+    size_t target = NONE;
+    for (size_t layer = via_record.lower_layer; layer <= via_record.upper_layer; layer++) {
+        auto source = via_hits.at(via_record.first_hit + layer - via_record.lower_layer);
+        if (source == NONE) {
             ok = false;
-            continue;
-        } else if (!target) {
+        } else if (target == NONE) {
             target = source;
-        } else if (source == target) {
-            continue;
         } else {
-            target->merge_with(source);
-            nets.remove(source);
+            merge(target, source);
         }
     }
-    if (target) {
-        target->add_via(via);
+    if (target != NONE) {
+        auto &set = sets.at(find_root(target));
+        auto via_index = vias.size();
+        vias.emplace_back(record, NONE);
+        if (set.last_via == NONE) {
+            set.first_via = via_index;
+        } else {
+            vias.at(set.last_via).second = via_index;
+        }
+        set.last_via = via_index;
     }
     return ok;
 }
 
 /**
- * Returns which net belongs to the given point. The returned pointer will
- * be null if there is no (virtual) copper at the given point.
+ * Returns the index of the shape at the given point on the given layer,
+ * or NONE if there is no copper there.
+ */
+size_t PhysicalNetlist::find_shape(coord::CPt point, size_t layer) const {
+    if (layer >= index.size()) {
+        return NONE;
+    }
+    const auto &grid = index.at(layer);
+    auto cell = grid.find(index_key(index_cell(point.X), index_cell(point.Y)));
+    if (cell == grid.end()) {
+        return NONE;
+    }
+    const auto &all_shapes = arena ? arena->shapes : shapes;
+    for (auto shape_index : cell->second) {
+        if (all_shapes.at(shape_index).contains(point)) {
+            return shape_index;
+        }
+    }
+    return NONE;
+}
+
+/**
+ * Returns the root of the set that the given shape belongs to,
+ * compressing the path to it along the way.
  */
-PhysicalNetRef PhysicalNetlist::find_net(coord::CPt point, size_t layer) const {
-    for (const auto &net : nets) {
-        if (net->contains(point, layer)) {
-            return net;
+size_t PhysicalNetlist::find_root(size_t shape) {
+    auto root = shape;
+    while (sets.at(root).parent != root) {
+        root = sets.at(root).parent;
+    }
+    while (shape != root) {
+        auto parent = sets.at(shape).parent;
+        sets.at(shape).parent = root;
+        shape = parent;
+    }
+    return root;
+}
+
+/**
+ * Merges the set of the source shape into the set of the target shape.
+ * Shapes and vias of the source set are ordered after those of the
+ * target.
+ */
+void PhysicalNetlist::merge(size_t target, size_t source) {
+    target = find_root(target);
+    source = find_root(source);
+    if (target == source) {
+        return;
+    }
+    auto t = sets.at(target);
+    auto s = sets.at(source);
+
+    // Concatenate the shape and via lists, target first.
+    sets.at(t.last_shape).next_shape = s.first_shape;
+    if (s.first_via != NONE) {
+        if (t.last_via == NONE) {
+            t.first_via = s.first_via;
+        } else {
+            vias.at(t.last_via).second = s.first_via;
+        }
+        t.last_via = s.last_via;
+    }
+
+    // Link the smaller tree below the larger one, and store the merged set
+    // data in whichever ends up as the root.
+    auto root = (t.size < s.size) ? source : target;
+    auto child = (root == target) ? source : target;
+    auto &r = sets.at(root);
+    r.size = t.size + s.size;
+    r.anchor = t.anchor;
+    r.first_shape = t.first_shape;
+    r.last_shape = s.last_shape;
+    r.first_via = t.first_via;
+    r.last_via = t.last_via;
+    sets.at(child).parent = root;
+}
+
+/**
+ * Creates the physical nets once all shapes and vias have been
+ * registered. Nothing can be registered after this, and the nets can only
+ * be queried after this.
+ */
+void PhysicalNetlist::finish() {
+    if (finished) return;
+    finished = true;
+    vias_added = true;
+
+    // Lay out the shapes and vias net by net, with the nets in the order of
+    // their anchor shapes.
+    auto new_arena = std::make_shared<NetArena>();
+    std::vector<ShapeId> shape_ids(shapes.size());
+    new_arena->shapes.reserve(shapes.size());
+    new_arena->shape_nets.reserve(shapes.size());
+    new_arena->vias.reserve(vias.size());
+    new_arena->via_nets.reserve(vias.size());
+    for (size_t anchor = 0; anchor < shapes.size(); anchor++) {
+        const auto &set = sets.at(find_root(anchor));
+        if (set.anchor != anchor) {
+            continue;
+        }
+        auto net = (NetId)new_arena->net_shapes.size();
+        new_arena->net_shapes.push_back((ShapeId)new_arena->shapes.size());
+        new_arena->net_vias.push_back((ViaId)new_arena->vias.size());
+        for (auto shape = set.first_shape; shape != NONE; shape = sets.at(shape).next_shape) {
+            shape_ids.at(shape) = (ShapeId)new_arena->shapes.size();
+            new_arena->shapes.push_back(std::move(shapes.at(shape)));
+            new_arena->shape_nets.push_back(net);
+        }
+        for (auto via = set.first_via; via != NONE; via = vias.at(via).second) {
+            new_arena->vias.push_back(via_records.at(vias.at(via).first).via);
+            new_arena->via_nets.push_back(net);
+        }
+    }
+    new_arena->net_shapes.push_back((ShapeId)new_arena->shapes.size());
+    new_arena->net_vias.push_back((ViaId)new_arena->vias.size());
+
+    // Renumber the spatial index and the via hits, and release the
+    // construction state.
+    for (auto &grid : index) {
+        for (auto &cell : grid) {
+            for (auto &shape : cell.second) {
+                shape = shape_ids.at(shape);
+            }
+        }
+    }
+    for (auto &hit : via_hits) {
+        if (hit != NONE) {
+            hit = shape_ids.at(hit);
+        }
+    }
+    registration_order = std::move(shape_ids);
+    shapes = {};
+    sets = {};
+    vias = {};
+    arena = new_arena;
+
+    // Create the views for the nets, all in one allocation.
+    auto net_count = arena->get_net_count();
+    nets = std::make_shared<std::vector<PhysicalNet>>();
+    nets->reserve(net_count);
+    for (size_t net = 0; net < net_count; net++) {
+        nets->emplace_back(arena, (NetId)net);
+    }
+}
+
+/**
+ * Returns the id of the net that the given point belongs to, or NO_NET
+ * if there is no (virtual) copper at the given point.
+ */
+NetId PhysicalNetlist::find_net(coord::CPt point, size_t layer) const {
+    if (!finished) throw std::logic_error("netlist must be finished before nets can be queried");
+    auto shape = find_shape(point, layer);
+    if (shape == NONE) {
+        return NO_NET;
+    }
+    return arena->shape_nets.at(shape);
+}
+
+/**
+ * Like find_net(), but for many points at once. The points are sorted
+ * spatially, such that all points that fall in the same cell of the
+ * spatial index are tested against its shapes together; cells are
+ * processed in parallel using up to num_threads threads (0 for the
+ * hardware concurrency). layers must have the same size as points.
+ */
+std::vector<NetId> PhysicalNetlist::find_nets(
+    const std::vector<coord::CPt> &points,
+    const std::vector<size_t> &layers,
+    size_t num_threads
+) const {
+    if (!finished) throw std::logic_error("netlist must be finished before nets can be queried");
+    if (points.size() != layers.size()) {
+        throw std::invalid_argument("number of points and layers differ");
+    }
+
+    // Sort the points by layer and index cell, and split them up into runs
+    // that share a cell. Points on layers without copper are dropped.
+    std::vector<size_t> order;
+    order.reserve(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        if (layers[i] < index.size()) {
+            order.push_back(i);
+        }
+    }
+    std::vector<uint64_t> keys(points.size());
+    for (auto i : order) {
+        keys[i] = index_key(index_cell(points[i].X), index_cell(points[i].Y));
+    }
+    std::sort(order.begin(), order.end(), [&layers, &keys](size_t a, size_t b) {
+        if (layers[a] != layers[b]) return layers[a] < layers[b];
+        if (keys[a] != keys[b]) return keys[a] < keys[b];
+        return a < b;
+    });
+    std::vector<size_t> runs;
+    for (size_t i = 0; i < order.size(); i++) {
+        if (!i || layers[order[i]] != layers[order[i - 1]] || keys[order[i]] != keys[order[i - 1]]) {
+            runs.push_back(i);
+        }
+    }
+    runs.push_back(order.size());
+
+    // Resolve the runs in parallel. Within a run, the points that are still
+    // unresolved are tested against each shape of the cell in turn, so the
+    // first shape in the cell that contains a point wins, as for find_net().
+    std::vector<NetId> result(points.size(), NO_NET);
+    parallel::for_each(runs.size() - 1, [&](size_t run) {
+        auto first = order[runs[run]];
+        const auto &grid = index.at(layers[first]);
+        auto cell = grid.find(keys[first]);
+        if (cell == grid.end()) {
+            return;
         }
+        std::vector<size_t> pending(order.begin() + runs[run], order.begin() + runs[run + 1]);
+        std::vector<coord::CPt> pending_points;
+        for (auto shape : cell->second) {
+            pending_points.clear();
+            for (auto i : pending) {
+                pending_points.push_back(points[i]);
+            }
+            auto inside = arena->shapes.at(shape).contains(pending_points);
+            size_t remaining = 0;
+            for (size_t j = 0; j < pending.size(); j++) {
+                if (inside[j]) {
+                    result[pending[j]] = arena->shape_nets.at(shape);
+                } else {
+                    pending[remaining++] = pending[j];
+                }
+            }
+            pending.resize(remaining);
+            if (pending.empty()) {
+                break;
+            }
+        }
+    }, num_threads);
+    return result;
+}
+
+/**
+ * Returns the physical net with the given id.
+ */
+PhysicalNetRef PhysicalNetlist::get_net(NetId net) const {
+    if (!finished) throw std::logic_error("netlist must be finished before nets can be queried");
+    return PhysicalNetRef(nets, &nets->at(net));
+}
+
+/**
+ * Returns all physical nets, by id.
+ */
+std::vector<PhysicalNetRef> PhysicalNetlist::get_nets() const {
+    std::vector<PhysicalNetRef> result;
+    if (nets) {
+        result.reserve(nets->size());
+        for (auto &net : *nets) {
+            result.emplace_back(nets, &net);
+        }
+    }
+    return result;
+}
+
+/**
+ * Returns the logical nets associated with the physical net with the
+ * given id.
+ */
+const LogicalNets &PhysicalNetlist::get_logical_nets(NetId net) const {
+    if (!finished) throw std::logic_error("netlist must be finished before nets can be queried");
+    return nets->at(net).get_logical_nets();
+}
+
+/**
+ * Returns the vias that are not connected to copper on one or more of
+ * their layers, in the order they were registered.
+ */
+std::vector<Via> PhysicalNetlist::get_unconnected_vias() const {
+    std::vector<Via> result;
+    for (const auto &record : via_records) {
+        auto first = via_hits.begin() + record.first_hit;
+        auto last = first + (record.upper_layer - record.lower_layer + 1);
+        if (std::find(first, last, NONE) != last) {
+            result.push_back(record.via);
+        }
+    }
+    return result;
+}
+
+/**
+ * Returns a finished copy of this netlist in which the copper on the
+ * given layer is replaced by the given paths. Only the shapes of that
+ * layer are recomputed and only the vias that reach it are located
+ * again; the shapes of the other layers and where the vias hit them are
+ * reused, such that only the cheap merging of the sets is redone. This
+ * netlist must be finished, and its shapes must have been registered
+ * layer by layer, bottom-up.
+ */
+PhysicalNetlist PhysicalNetlist::replace_layer(size_t layer, const coord::Paths &paths) const {
+    if (!finished) throw std::logic_error("netlist must be finished before a layer can be replaced");
+    PhysicalNetlist result;
+
+    // Register the shapes in the original order, copying the shapes of the
+    // other layers along with their indices rather than recomputing them, and
+    // slotting in the new shapes where the old ones were.
+    std::vector<size_t> new_indices(arena->shapes.size(), NONE);
+    bool replaced = false;
+    for (auto id : registration_order) {
+        const auto &shape = arena->shapes.at(id);
+        if (shape.get_layer() == layer) {
+            continue;
+        }
+        if (!replaced && shape.get_layer() > layer) {
+            result.register_paths(paths, layer);
+            replaced = true;
+        }
+        new_indices.at(id) = result.shapes.size();
+        result.register_shape(shape);
+    }
+    if (!replaced) {
+        result.register_paths(paths, layer);
     }
-    return {};
+
+    // Replay the vias. Only hits on the replaced layer need to be located
+    // again; the others are mapped to the reregistered shapes.
+    result.vias_added = true;
+    result.via_records.reserve(via_records.size());
+    result.via_hits.reserve(via_hits.size());
+    for (const auto &record : via_records) {
+        result.via_records.push_back({record.via, record.lower_layer, record.upper_layer, result.via_hits.size()});
+        for (auto via_layer = record.lower_layer; via_layer <= record.upper_layer; via_layer++) {
+            if (via_layer == layer) {
+                result.via_hits.push_back(result.find_shape(record.via.get_coordinate(), layer));
+            } else {
+                auto hit = via_hits.at(record.first_hit + via_layer - record.lower_layer);
+                result.via_hits.push_back(hit == NONE ? NONE : new_indices.at(hit));
+            }
+        }
+        result.connect_via(result.via_records.size() - 1);
+    }
+    result.finish();
+    return result;
 }
 
 /**
- * Returns the list of all physical nets.
+ * Returns the dense storage for the shapes and vias of the nets.
  */
-const std::list<PhysicalNetRef> &PhysicalNetlist::get_nets() const {
-    return nets;
+const NetArena &PhysicalNetlist::get_arena() const {
+    if (!arena) throw std::logic_error("netlist must be finished before its arena can be queried");
+    return *arena;
 }
 
 /**
@@ -418,10 +944,68 @@ size_t ConnectionPoint::get_layer(size_t num_layers) const {
 /**
  * Returns the logical net for this connection point.
  */
-LogicalNetRef ConnectionPoint::get_net() const {
+const LogicalNetRef &ConnectionPoint::get_net() const {
     return net;
 }
 
+/**
+ * Formats the violation as a human-readable message.
+ */
+std::string Violation::to_string() const {
+    std::ostringstream ss;
+    switch (type) {
+        case ViolationType::UNCONNECTED_VIA:
+            ss << "via at coordinate (";
+            ss << coord::Format::to_mm(coordinate.X);
+            ss << ", ";
+            ss << coord::Format::to_mm(coordinate.Y);
+            ss << ") is not connected to copper on one or more layers";
+            break;
+        case ViolationType::MISSING_COPPER:
+            ss << "connection at coordinate (";
+            ss << coord::Format::to_mm(coordinate.X);
+            ss << ", ";
+            ss << coord::Format::to_mm(coordinate.Y);
+            ss << ") on layer " << layer;
+            ss << " should be connected to logical net " << net;
+            ss << ", but there is no copper here";
+            break;
+        case ViolationType::UNROUTED_NET:
+            ss << "logical net " << net << " is completely unrouted";
+            break;
+        case ViolationType::DIVIDED_NET:
+            ss << "logical net " << net << " is divided up into ";
+            ss << islands << " islands";
+            break;
+        case ViolationType::SHORT_CIRCUIT:
+            ss << "logical nets " << net << " and " << other_net << " are short-circuited";
+            break;
+        case ViolationType::CLEARANCE:
+            ss << "clearance violation between " << net << " and " << other_net;
+            break;
+        case ViolationType::ANNULAR_RING:
+            ss << "via at coordinate (";
+            ss << coord::Format::to_mm(coordinate.X);
+            ss << ", ";
+            ss << coord::Format::to_mm(coordinate.Y);
+            ss << ") has annular ring ";
+            ss << coord::Format::to_mm(annular_ring);
+            ss << ", less than the minimum ";
+            ss << coord::Format::to_mm(minimum);
+            break;
+    }
+    return ss.str();
+}
+
+/**
+ * Returns a violation of the given type with all other fields cleared.
+ */
+static Violation make_violation(ViolationType type) {
+    Violation violation{};
+    violation.type = type;
+    return violation;
+}
+
 /**
  * Adds a copper layer. The layers are added bottom-up. All layers must be
  * added before vias are added.
@@ -443,13 +1027,13 @@ NetlistBuilder &NetlistBuilder::via(
     int lower_layer,
     int upper_layer
 ) {
-    vias.push_back(std::make_shared<Via>(
+    vias.emplace_back(
         path,
         finished_hole_size,
         plating_thickness,
         lower_layer,
         upper_layer
-    ));
+    );
     return *this;
 }
 
@@ -457,12 +1041,41 @@ NetlistBuilder &NetlistBuilder::via(
  * Associates a point on the PCB with a logical net name.
  */
 NetlistBuilder &NetlistBuilder::net(coord::CPt point, int layer, const std::string &net_name) {
+    connections.emplace_back(point, layer, find_or_add_net(net_name));
+    return *this;
+}
+
+/**
+ * Associates many points on the PCB with logical nets at once. The net
+ * of each record is an index into net_names. This is equivalent to
+ * calling net() for each record, but looks up each net name only once.
+ */
+NetlistBuilder &NetlistBuilder::add_connections(const std::vector<std::string> &net_names, const std::vector<ConnectionRecord> &records) {
+    std::vector<LogicalNetRef> logical_nets;
+    logical_nets.reserve(net_names.size());
+    for (const auto &net_name : net_names) {
+        logical_nets.push_back(find_or_add_net(net_name));
+    }
+    connections.reserve(connections.size() + records.size());
+    for (const auto &record : records) {
+        if (record.net >= logical_nets.size()) {
+            throw std::out_of_range("connection refers to unknown net index " + std::to_string(record.net));
+        }
+        connections.emplace_back(record.coordinate, record.layer, logical_nets[record.net]);
+    }
+    return *this;
+}
+
+/**
+ * Returns the logical net with the given name, creating it if it does
+ * not exist yet.
+ */
+const LogicalNetRef &NetlistBuilder::find_or_add_net(const std::string &net_name) {
     auto it = nets.find(net_name);
     if (it == nets.end()) {
         it = nets.insert({net_name, std::make_shared<LogicalNet>(net_name)}).first;
     }
-    connections.emplace_back(point, layer, it->second);
-    return *this;
+    return it->second;
 }
 
 /**
@@ -474,59 +1087,108 @@ Netlist NetlistBuilder::build(coord::CInt clearance) {
 
     // Convert and add the copper shapes for all layers.
     nl.num_layers = 0;
+    nl.clearance = clearance;
     for (const auto &paths : layers) {
         nl.connected_netlist.register_paths(paths, nl.num_layers);
-        auto extended_paths = path::offset(paths, (double)clearance / 2, false);
-        nl.clearance_netlist.register_paths(extended_paths, nl.num_layers);
         nl.num_layers++;
     }
 
     // Register vias.
     for (const auto &via : vias) {
         if (!nl.connected_netlist.register_via(via, nl.num_layers)) {
-            std::ostringstream ss;
-            ss << "via at coordinate (";
-            ss << coord::Format::to_mm(via->get_coordinate().X);
-            ss << ", ";
-            ss << coord::Format::to_mm(via->get_coordinate().Y);
-            ss << ") is not connected to copper on one or more layers";
-            nl.builder_violations.push_back(ss.str());
+            auto violation = make_violation(ViolationType::UNCONNECTED_VIA);
+            violation.coordinate = via.get_coordinate();
+            nl.builder_violations.push_back(std::move(violation));
         }
-        nl.clearance_netlist.register_via(via, nl.num_layers);
     }
+    nl.connected_netlist.finish();
 
-    // Register logical nets.
+    // Register logical nets and the connection points that connect them to
+    // the physical nets.
     nl.logical_nets = std::move(nets);
+    nl.connections = std::move(connections);
+    nl.assign_connections();
 
-    // Register connection points to connect the logical and physical nets.
+    return nl;
+}
+
+/**
+ * Resolves the connection points to physical nets and associates the
+ * logical and physical nets accordingly. Connection points without
+ * copper are recorded as violations.
+ */
+void Netlist::assign_connections() {
+    // The points are resolved to physical nets in bulk, but processed in the
+    // order they were added.
+    std::vector<coord::CPt> points;
+    std::vector<size_t> point_layers;
+    points.reserve(connections.size());
+    point_layers.reserve(connections.size());
     for (const auto &connection : connections) {
-        const auto coord = connection.get_coordinate();
-        const auto layer = connection.get_layer(nl.num_layers);
-        const auto logical_net = connection.get_net();
-        auto connected_net = nl.connected_netlist.find_net(coord, layer);
-        if (!connected_net) {
-            std::ostringstream ss;
-            ss << "connection at coordinate (";
-            ss << coord::Format::to_mm(connection.get_coordinate().X);
-            ss << ", ";
-            ss << coord::Format::to_mm(connection.get_coordinate().Y);
-            ss << ") on layer ";
-            ss << coord::Format::to_mm(connection.get_layer(nl.num_layers));
-            ss << " should be connected to logical net ";
-            ss << logical_net->get_name();
-            ss << ", but there is no copper here";
-            nl.builder_violations.push_back(ss.str());
+        points.push_back(connection.get_coordinate());
+        point_layers.push_back(connection.get_layer(num_layers));
+    }
+    // Many points connect the same pair of nets, so the physical net is
+    // only referenced for the first of them.
+    auto connected_nets = connected_netlist.find_nets(points, point_layers);
+    std::set<std::pair<NetId, const LogicalNet*>> assigned;
+    for (size_t i = 0; i < connections.size(); i++) {
+        const auto coord = points[i];
+        const auto layer = point_layers[i];
+        const auto &logical_net = connections[i].get_net();
+        const auto connected_net = connected_nets[i];
+        if (connected_net == NO_NET) {
+            auto violation = make_violation(ViolationType::MISSING_COPPER);
+            violation.coordinate = coord;
+            violation.layer = layer;
+            violation.net = logical_net->get_name();
+            builder_violations.push_back(std::move(violation));
             continue;
         }
-        auto clearance_net = nl.clearance_netlist.find_net(coord, layer);
-        if (!clearance_net) {
-            throw std::logic_error("point maps to connected netlist but not to clearance netlist");
+        if (!assigned.insert({connected_net, logical_net.get()}).second) {
+            continue;
         }
-        connected_net->assign_logical(logical_net);
-        clearance_net->assign_logical(logical_net);
-        logical_net->assign_physical(connected_net, clearance_net);
+        auto physical_net = connected_netlist.get_net(connected_net);
+        physical_net->assign_logical(logical_net);
+        logical_net->assign_physical(physical_net);
+    }
+}
+
+/**
+ * Returns a copy of this netlist in which the copper on the given layer
+ * (0 to N-1 for bottom to top) is replaced by the given paths, as if it
+ * were rebuilt with the same vias and connection points. Only the work
+ * that depends on the replaced layer is redone; see
+ * PhysicalNetlist::replace_layer().
+ */
+Netlist Netlist::replace_layer(size_t layer, const coord::Paths &paths) const {
+    if (layer >= num_layers) {
+        throw std::out_of_range("layer index " + std::to_string(layer) + " out of range");
+    }
+    Netlist nl;
+    nl.num_layers = num_layers;
+    nl.clearance = clearance;
+    nl.connected_netlist = connected_netlist.replace_layer(layer, paths);
+    for (const auto &via : nl.connected_netlist.get_unconnected_vias()) {
+        auto violation = make_violation(ViolationType::UNCONNECTED_VIA);
+        violation.coordinate = via.get_coordinate();
+        nl.builder_violations.push_back(std::move(violation));
     }
 
+    // The logical nets refer to the physical nets they are connected to, so
+    // the new netlist needs its own.
+    for (const auto &it : logical_nets) {
+        nl.logical_nets.emplace(it.first, std::make_shared<LogicalNet>(it.first));
+    }
+    nl.connections.reserve(connections.size());
+    for (const auto &connection : connections) {
+        nl.connections.emplace_back(
+            connection.get_coordinate(),
+            (int)connection.get_layer(num_layers),
+            nl.logical_nets.at(connection.get_net()->get_name())
+        );
+    }
+    nl.assign_connections();
     return nl;
 }
 
@@ -573,14 +1235,13 @@ static double point_to_line_distance_sqr(coord::CPt point, coord::CPt a, coord::
 }
 
 /**
- * Returns the square of the distance between the given point and a closed path.
- *
- * NOTE: this is not exactly the most efficient implementation.
+ * Returns the square of the distance between the given point and a path,
+ * including the closing segment if the path is closed.
  */
-static double point_to_path_distance_sqr(coord::CPt point, coord::Path p, bool closed) {
+static double point_to_path_distance_sqr(coord::CPt point, const coord::Path &p, bool closed) {
     double r_sqr_min = std::numeric_limits<double>::infinity();
-    if (closed) {
-        point_to_line_distance_sqr(point, p.front(), p.back());
+    if (closed && !p.empty()) {
+        r_sqr_min = point_to_line_distance_sqr(point, p.front(), p.back());
     }
     for (size_t i = 1; i < p.size(); i++) {
         r_sqr_min = std::min(r_sqr_min, point_to_line_distance_sqr(point, p.at(i-1), p.at(i)));
@@ -589,117 +1250,549 @@ static double point_to_path_distance_sqr(coord::CPt point, coord::Path p, bool c
 }
 
 /**
- * Returns the minimum annular ring for the given via.
+ * Constructs an index for the given segments.
  */
-static double compute_annular_ring(const ViaRef &via, const PhysicalNetRef &net) {
-    double r_sqr_min = std::numeric_limits<double>::infinity();
-    for (const auto &vc : via->get_path()) {
-        for (const auto &shape : net->get_shapes()) {
-            r_sqr_min = std::min(r_sqr_min, point_to_path_distance_sqr(vc, shape->get_outline(), true));
-            for (const auto &hole : shape->get_holes()) {
-                r_sqr_min = std::min(r_sqr_min, point_to_path_distance_sqr(vc, hole, true));
+SegmentIndex::SegmentIndex(std::vector<Segment> segments) :
+    segments(std::move(segments)),
+    cell_size(1),
+    min_x(0), min_y(0), max_x(-1), max_y(-1)
+{
+    if (this->segments.empty()) {
+        return;
+    }
+
+    // Choose the cell size such that there are no more cells than segments,
+    // and segments typically overlap only one or two cells.
+    coord::CRect box;
+    box.left = box.right = this->segments.front().first.X;
+    box.bottom = box.top = this->segments.front().first.Y;
+    double total_length = 0.0;
+    for (const auto &segment : this->segments) {
+        for (const auto &point : {segment.first, segment.second}) {
+            box.left = std::min(box.left, point.X);
+            box.bottom = std::min(box.bottom, point.Y);
+            box.right = std::max(box.right, point.X);
+            box.top = std::max(box.top, point.Y);
+        }
+        total_length += std::sqrt(point_to_line_distance_sqr(segment.first, segment.second, segment.second));
+    }
+    double count = (double)this->segments.size();
+    double area = ((double)(box.right - box.left) + 1.0) * ((double)(box.top - box.bottom) + 1.0);
+    cell_size = (coord::CInt)std::ceil(std::max({1.0, total_length / count, std::sqrt(area / count)}));
+
+    min_x = index_cell(box.left, cell_size);
+    min_y = index_cell(box.bottom, cell_size);
+    max_x = index_cell(box.right, cell_size);
+    max_y = index_cell(box.top, cell_size);
+    for (size_t i = 0; i < this->segments.size(); i++) {
+        const auto &segment = this->segments.at(i);
+        auto x1 = index_cell(std::min(segment.first.X, segment.second.X), cell_size);
+        auto x2 = index_cell(std::max(segment.first.X, segment.second.X), cell_size);
+        auto y1 = index_cell(std::min(segment.first.Y, segment.second.Y), cell_size);
+        auto y2 = index_cell(std::max(segment.first.Y, segment.second.Y), cell_size);
+        for (auto x = x1; x <= x2; x++) {
+            for (auto y = y1; y <= y2; y++) {
+                cells[index_key(x, y)].push_back((uint32_t)i);
             }
         }
     }
-    if (via->get_path().size() > 1) {
-        for (const auto &shape : net->get_shapes()) {
-            for (const auto &pt : shape->get_outline()) {
-                r_sqr_min = std::min(r_sqr_min, point_to_path_distance_sqr(pt, via->get_path(), false));
+}
+
+/**
+ * Calls fn for the indices of all segments in the given cell.
+ */
+template <typename F>
+void SegmentIndex::visit_cell(int64_t x, int64_t y, F fn) const {
+    if (x < min_x || x > max_x || y < min_y || y > max_y) {
+        return;
+    }
+    auto cell = cells.find(index_key(x, y));
+    if (cell == cells.end()) {
+        return;
+    }
+    for (auto i : cell->second) {
+        fn(i);
+    }
+}
+
+/**
+ * Returns the squared distance from the given point to the nearest
+ * segment, or infinity if there are no segments.
+ */
+double SegmentIndex::nearest_distance_sqr(coord::CPt point) const {
+    double r_sqr_min = std::numeric_limits<double>::infinity();
+    if (segments.empty()) {
+        return r_sqr_min;
+    }
+    auto update = [this, point, &r_sqr_min](uint32_t i) {
+        const auto &segment = segments[i];
+        r_sqr_min = std::min(r_sqr_min, point_to_line_distance_sqr(point, segment.first, segment.second));
+    };
+
+    // Visit rings of cells around the point's cell, moving outward. All cells
+    // beyond ring k are at least k cells away, so once the nearest segment
+    // found is closer than that, we're done. Rings that do not overlap the
+    // grid are skipped.
+    auto cx = index_cell(point.X, cell_size);
+    auto cy = index_cell(point.Y, cell_size);
+    auto k_start = std::max({(int64_t)0, min_x - cx, cx - max_x, min_y - cy, cy - max_y});
+    auto k_end = std::max({cx - min_x, max_x - cx, cy - min_y, max_y - cy});
+    for (auto k = k_start; k <= k_end; k++) {
+        if (k == 0) {
+            visit_cell(cx, cy, update);
+        } else {
+            for (auto x = cx - k; x <= cx + k; x++) {
+                visit_cell(x, cy - k, update);
+                visit_cell(x, cy + k, update);
             }
-            for (const auto &hole : shape->get_holes()) {
-                for (const auto &pt : hole) {
-                    r_sqr_min = std::min(r_sqr_min, point_to_path_distance_sqr(pt, via->get_path(), false));
-                }
+            for (auto y = cy - k + 1; y <= cy + k - 1; y++) {
+                visit_cell(cx - k, y, update);
+                visit_cell(cx + k, y, update);
             }
         }
+        double reach = (double)k * (double)cell_size;
+        if (r_sqr_min <= reach * reach) {
+            break;
+        }
     }
-    return std::sqrt(r_sqr_min) - (double)via->get_finished_hole_size() / 2;
+    return r_sqr_min;
 }
 
 /**
- * Runs the design-rule check. A list of violation messages is returned. If
- * any message is returned, the DRC failed.
+ * Calls fn for every segment that may overlap the given rectangle. A
+ * segment may be visited more than once.
  */
-std::list<std::string> Netlist::perform_drc(coord::CInt annular_ring) const {
-    auto violations = builder_violations;
+void SegmentIndex::visit(const coord::CRect &rect, const std::function<void(const Segment&)> &fn) const {
+    auto x1 = std::max(min_x, index_cell(rect.left, cell_size));
+    auto x2 = std::min(max_x, index_cell(rect.right, cell_size));
+    auto y1 = std::max(min_y, index_cell(rect.bottom, cell_size));
+    auto y2 = std::min(max_y, index_cell(rect.top, cell_size));
+    for (auto x = x1; x <= x2; x++) {
+        for (auto y = y1; y <= y2; y++) {
+            visit_cell(x, y, [this, &fn](uint32_t i) { fn(segments[i]); });
+        }
+    }
+}
 
-    // Check for open circuits.
+/**
+ * Calls fn for all outline and hole segments of the given shape, including
+ * the closing segments.
+ */
+template <typename F>
+static void for_each_segment(const Shape &shape, F fn) {
+    auto visit_ring = [&fn](const coord::Path &path) {
+        for (size_t i = 0; i < path.size(); i++) {
+            fn(Segment(path[i], path[(i + 1) % path.size()]));
+        }
+    };
+    visit_ring(shape.get_outline());
+    for (const auto &hole : shape.get_holes()) {
+        visit_ring(hole);
+    }
+}
+
+/**
+ * Returns all outline and hole segments of the given shape, including the
+ * closing segments.
+ */
+static std::vector<Segment> shape_segments(const Shape &shape) {
+    std::vector<Segment> segments;
+    for_each_segment(shape, [&segments](const Segment &segment) {
+        segments.push_back(segment);
+    });
+    return segments;
+}
+
+/**
+ * Returns all outline and hole segments of the shapes of the given net,
+ * including the closing segments.
+ */
+static std::vector<Segment> net_segments(const NetArena &arena, NetId net) {
+    std::vector<Segment> segments;
+    for (const auto &shape : arena.get_shapes(net)) {
+        for_each_segment(shape, [&segments](const Segment &segment) {
+            segments.push_back(segment);
+        });
+    }
+    return segments;
+}
+
+/**
+ * Returns the minimum annular ring for the given via.
+ */
+static double compute_annular_ring(const Via &via, const SegmentIndex &net_segments) {
+    double r_sqr_min = std::numeric_limits<double>::infinity();
+    for (const auto &vc : via.get_path()) {
+        r_sqr_min = std::min(r_sqr_min, net_segments.nearest_distance_sqr(vc));
+    }
+
+    // For slots, the copper vertices nearest to the milling path may also be
+    // closer than anything found above. Only vertices within the distance
+    // found thus far can be, and every vertex starts a segment.
+    const auto &path = via.get_path();
+    if (path.size() > 1 && std::isfinite(r_sqr_min)) {
+        auto reach = (coord::CInt)std::ceil(std::sqrt(r_sqr_min));
+        coord::CRect rect;
+        rect.left = rect.right = path.front().X;
+        rect.bottom = rect.top = path.front().Y;
+        for (const auto &pt : path) {
+            rect.left = std::min(rect.left, pt.X - reach);
+            rect.bottom = std::min(rect.bottom, pt.Y - reach);
+            rect.right = std::max(rect.right, pt.X + reach);
+            rect.top = std::max(rect.top, pt.Y + reach);
+        }
+        net_segments.visit(rect, [&path, &r_sqr_min](const Segment &segment) {
+            r_sqr_min = std::min(r_sqr_min, point_to_path_distance_sqr(segment.first, path, false));
+        });
+    }
+    return std::sqrt(r_sqr_min) - (double)via.get_finished_hole_size() / 2;
+}
+
+/**
+ * Reports logical nets that are unrouted or divided up into islands.
+ */
+static std::vector<Violation> check_open_circuits(const std::map<std::string, LogicalNetRef> &logical_nets) {
+    std::vector<Violation> violations;
     for (const auto &it : logical_nets) {
         auto net = it.second;
         auto pnets = net->get_connected_nets();
         if (pnets.empty()) {
-            std::ostringstream ss;
-            ss << "logical net " << net->get_name() << " is completely unrouted";
-            violations.push_back(ss.str());
+            auto violation = make_violation(ViolationType::UNROUTED_NET);
+            violation.net = net->get_name();
+            violations.push_back(std::move(violation));
         } else if (pnets.size() > 1) {
-            std::ostringstream ss;
-            ss << "logical net " << net->get_name() << " is divided up into ";
-            ss << pnets.size() << " islands";
-            violations.push_back(ss.str());
+            auto violation = make_violation(ViolationType::DIVIDED_NET);
+            violation.net = net->get_name();
+            violation.islands = pnets.size();
+            violations.push_back(std::move(violation));
         }
     }
+    return violations;
+}
 
-    // Check for short circuits.
-    std::set<std::pair<std::string, std::string>> shorts_reported;
-    for (const auto &net : connected_netlist.get_nets()) {
-        auto lnets = net->get_logical_nets();
+/**
+ * Reports each pair of logical nets that share a physical net in the given
+ * netlist once, as a violation of the given type. The names within a pair
+ * are ordered alphabetically, so the result does not depend on where the
+ * logical nets happen to be allocated.
+ */
+static std::vector<Violation> check_net_pairs(const PhysicalNetlist &netlist, ViolationType type) {
+    std::vector<Violation> violations;
+    std::set<std::pair<std::string, std::string>> reported;
+    for (NetId net = 0; net < netlist.get_arena().get_net_count(); net++) {
+        const auto &lnets = netlist.get_logical_nets(net);
         if (lnets.size() < 2) continue;
-        for (const auto &a : lnets) {
-            auto net_a = a.lock()->get_name();
-            for (const auto &b : lnets) {
-                auto net_b = b.lock()->get_name();
-                if (net_a == net_b) continue;
-                if (shorts_reported.count({net_a, net_b})) continue;
-                shorts_reported.insert({net_a, net_b});
-                shorts_reported.insert({net_b, net_a});
-                std::ostringstream ss;
-                ss << "logical nets " << net_a << " and " << net_b << " are short-circuited";
-                violations.push_back(ss.str());
+        std::vector<std::string> names;
+        for (const auto &lnet : lnets) {
+            names.push_back(lnet.lock()->get_name());
+        }
+        std::sort(names.begin(), names.end());
+        for (size_t i = 0; i < names.size(); i++) {
+            for (size_t j = i + 1; j < names.size(); j++) {
+                if (!reported.insert({names[i], names[j]}).second) continue;
+                auto violation = make_violation(type);
+                violation.net = names[i];
+                violation.other_net = names[j];
+                violations.push_back(std::move(violation));
             }
         }
     }
+    return violations;
+}
 
-    // Check for clearance violations.
-    for (const auto &net : clearance_netlist.get_nets()) {
-        auto lnets = net->get_logical_nets();
-        if (lnets.size() < 2) continue;
-        for (const auto &a : lnets) {
-            auto net_a = a.lock()->get_name();
-            for (const auto &b : lnets) {
-                auto net_b = b.lock()->get_name();
-                if (net_a == net_b) continue;
-                if (shorts_reported.count({net_a, net_b})) continue;
-                shorts_reported.insert({net_a, net_b});
-                shorts_reported.insert({net_b, net_a});
-                std::ostringstream ss;
-                ss << "clearance violation between " << net_a << " and " << net_b;
-                violations.push_back(ss.str());
+/**
+ * Reports vias with less annular ring than the given minimum. The segments
+ * of each net are indexed once and shared by its vias; both the indexing
+ * and the per-via checks run in parallel.
+ */
+static std::vector<Violation> check_annular_rings(
+    const PhysicalNetlist &netlist,
+    coord::CInt annular_ring,
+    size_t num_threads
+) {
+    const auto &arena = netlist.get_arena();
+    auto net_count = arena.get_net_count();
+    std::vector<std::unique_ptr<SegmentIndex>> net_indices(net_count);
+    parallel::for_each(net_count, [&arena, &net_indices](size_t net) {
+        if (!arena.get_vias((NetId)net).empty()) {
+            net_indices[net] = std::make_unique<SegmentIndex>(net_segments(arena, (NetId)net));
+        }
+    }, num_threads);
+    std::vector<double> via_annular_rings(arena.vias.size());
+    parallel::for_each(arena.vias.size(), [&arena, &net_indices, &via_annular_rings](size_t via) {
+        const auto &net_index = *net_indices[arena.via_nets[via]];
+        via_annular_rings[via] = compute_annular_ring(arena.vias[via], net_index);
+    }, num_threads);
+    std::vector<Violation> violations;
+    for (size_t i = 0; i < arena.vias.size(); i++) {
+        if (via_annular_rings[i] < annular_ring) {
+            auto violation = make_violation(ViolationType::ANNULAR_RING);
+            violation.coordinate = arena.vias[i].get_coordinate();
+            violation.annular_ring = via_annular_rings[i];
+            violation.minimum = annular_ring;
+            violations.push_back(std::move(violation));
+        }
+    }
+    return violations;
+}
+
+/**
+ * Returns the squared distance between two line segments that do not cross.
+ * Copper shapes on the same layer are disjoint, so their boundaries never
+ * do.
+ */
+static double segment_distance_sqr(const Segment &a, const Segment &b) {
+    return std::min({
+        point_to_line_distance_sqr(a.first, b.first, b.second),
+        point_to_line_distance_sqr(a.second, b.first, b.second),
+        point_to_line_distance_sqr(b.first, a.first, a.second),
+        point_to_line_distance_sqr(b.second, a.first, a.second)
+    });
+}
+
+/**
+ * Returns the bounding box of the given segment, grown by the given distance
+ * on all sides.
+ */
+static coord::CRect segment_bounds(const Segment &segment, coord::CInt distance) {
+    coord::CRect rect;
+    rect.left = std::min(segment.first.X, segment.second.X) - distance;
+    rect.right = std::max(segment.first.X, segment.second.X) + distance;
+    rect.bottom = std::min(segment.first.Y, segment.second.Y) - distance;
+    rect.top = std::max(segment.first.Y, segment.second.Y) + distance;
+    return rect;
+}
+
+/**
+ * Returns whether the given rectangles overlap.
+ */
+static bool rects_overlap(const coord::CRect &a, const coord::CRect &b) {
+    return a.left <= b.right && b.left <= a.right && a.bottom <= b.top && b.bottom <= a.top;
+}
+
+/**
+ * Returns whether the boundary of the given shape comes closer than the
+ * given distance to any of the indexed segments, which lie within the given
+ * bounding box.
+ */
+static bool shape_within_distance(
+    const Shape &shape,
+    const SegmentIndex &other,
+    const coord::CRect &other_box,
+    coord::CInt distance
+) {
+    double limit = (double)distance * (double)distance;
+    bool found = false;
+    for_each_segment(shape, [&](const Segment &segment) {
+        if (found) return;
+        auto rect = segment_bounds(segment, distance);
+        if (!rects_overlap(rect, other_box)) return;
+        other.visit(rect, [&](const Segment &other_segment) {
+            if (!found && segment_distance_sqr(segment, other_segment) < limit) {
+                found = true;
             }
+        });
+    });
+    return found;
+}
+
+/**
+ * Reports each pair of logical nets whose copper comes closer to each other
+ * than the given clearance once. Candidate pairs of shapes are found by
+ * sweeping over their bounding boxes, each grown by half the clearance;
+ * the candidates are then checked by the exact distance between their
+ * boundaries, in parallel per pair of physical nets. Only copper that
+ * belongs to a logical net is considered.
+ */
+static std::vector<Violation> check_clearance(
+    const PhysicalNetlist &netlist,
+    coord::CInt clearance,
+    size_t num_threads
+) {
+    std::vector<Violation> violations;
+    if (clearance <= 0) {
+        return violations;
+    }
+
+    // Gather the shapes of the nets that are assigned to a logical net.
+    const auto &arena = netlist.get_arena();
+    std::vector<std::vector<std::string>> net_names(arena.get_net_count());
+    std::vector<ShapeId> order;
+    std::vector<coord::CRect> boxes(arena.shapes.size());
+    auto margin = (clearance + 1) / 2;
+    for (NetId net = 0; net < arena.get_net_count(); net++) {
+        const auto &lnets = netlist.get_logical_nets(net);
+        if (lnets.empty()) continue;
+        auto &names = net_names[net];
+        for (const auto &lnet : lnets) {
+            names.push_back(lnet.lock()->get_name());
+        }
+        std::sort(names.begin(), names.end());
+        for (auto shape = arena.net_shapes[net]; shape < arena.net_shapes[net + 1]; shape++) {
+            const auto &box = arena.shapes[shape].get_bounding_box();
+            auto &rect = boxes[shape];
+            rect.left = box.left - margin;
+            rect.right = box.right + margin;
+            rect.bottom = box.bottom - margin;
+            rect.top = box.top + margin;
+            order.push_back(shape);
         }
     }
 
-    // Check for annular ring violations.
-    for (const auto &net : connected_netlist.get_nets()) {
-        for (const auto &via : net->get_vias()) {
-            auto via_annular_ring = compute_annular_ring(via, net);
-            if (via_annular_ring < annular_ring) {
-                std::ostringstream ss;
-                ss << "via at coordinate (";
-                ss << coord::Format::to_mm(via->get_coordinate().X);
-                ss << ", ";
-                ss << coord::Format::to_mm(via->get_coordinate().Y);
-                ss << ") has annular ring ";
-                ss << coord::Format::to_mm(via_annular_ring);
-                ss << ", less than the minimum ";
-                ss << coord::Format::to_mm(annular_ring);
-                violations.push_back(ss.str());
+    // Sweep over the grown bounding boxes per layer from left to right to
+    // find pairs of shapes that may be too close. Pairs of nets that carry
+    // only the same single logical net are of no interest. The candidates
+    // are grouped by the pair of nets they belong to.
+    std::sort(order.begin(), order.end(), [&arena, &boxes](ShapeId a, ShapeId b) {
+        auto layer_a = arena.shapes[a].get_layer();
+        auto layer_b = arena.shapes[b].get_layer();
+        if (layer_a != layer_b) return layer_a < layer_b;
+        if (boxes[a].left != boxes[b].left) return boxes[a].left < boxes[b].left;
+        return a < b;
+    });
+    using ShapePairs = std::vector<std::pair<ShapeId, ShapeId>>;
+    std::map<std::pair<NetId, NetId>, ShapePairs> candidates;
+    for (size_t i = 0; i < order.size(); i++) {
+        auto a = order[i];
+        for (size_t j = i + 1; j < order.size(); j++) {
+            auto b = order[j];
+            if (arena.shapes[b].get_layer() != arena.shapes[a].get_layer()) break;
+            if (boxes[b].left > boxes[a].right) break;
+            if (!rects_overlap(boxes[a], boxes[b])) continue;
+            auto net_a = arena.shape_nets[a];
+            auto net_b = arena.shape_nets[b];
+            if (net_a == net_b) continue;
+            if (net_names[net_a].size() == 1 && net_names[net_a] == net_names[net_b]) continue;
+            candidates[std::minmax(net_a, net_b)].emplace_back(a, b);
+        }
+    }
+    if (candidates.empty()) {
+        return violations;
+    }
+
+    // Index the segments of the larger shape of each candidate pair; the
+    // segments of the smaller shape are looked up in it.
+    auto vertex_count = [&arena](ShapeId shape) {
+        size_t count = arena.shapes[shape].get_outline().size();
+        for (const auto &hole : arena.shapes[shape].get_holes()) {
+            count += hole.size();
+        }
+        return count;
+    };
+    std::vector<size_t> shape_sizes(arena.shapes.size(), 0);
+    std::vector<char> indexed(arena.shapes.size(), 0);
+    for (auto &it : candidates) {
+        for (auto &pair : it.second) {
+            if (!shape_sizes[pair.first]) shape_sizes[pair.first] = vertex_count(pair.first);
+            if (!shape_sizes[pair.second]) shape_sizes[pair.second] = vertex_count(pair.second);
+            if (shape_sizes[pair.first] > shape_sizes[pair.second]) {
+                std::swap(pair.first, pair.second);
             }
+            indexed[pair.second] = 1;
         }
     }
+    std::vector<ShapeId> to_index;
+    for (size_t i = 0; i < arena.shapes.size(); i++) {
+        if (indexed[i]) to_index.push_back((ShapeId)i);
+    }
+    std::vector<std::unique_ptr<SegmentIndex>> indices(arena.shapes.size());
+    parallel::for_each(to_index.size(), [&to_index, &arena, &indices](size_t i) {
+        auto shape = to_index[i];
+        indices[shape] = std::make_unique<SegmentIndex>(shape_segments(arena.shapes[shape]));
+    }, num_threads);
+
+    // Check the pairs of nets in parallel, stopping at the first pair of
+    // shapes that is too close.
+    std::vector<std::pair<std::pair<NetId, NetId>, ShapePairs>> groups(
+        std::make_move_iterator(candidates.begin()),
+        std::make_move_iterator(candidates.end())
+    );
+    std::vector<char> too_close(groups.size(), 0);
+    parallel::for_each(groups.size(), [&](size_t i) {
+        for (const auto &pair : groups[i].second) {
+            const auto &box = arena.shapes[pair.second].get_bounding_box();
+            if (shape_within_distance(arena.shapes[pair.first], *indices[pair.second], box, clearance)) {
+                too_close[i] = 1;
+                break;
+            }
+        }
+    }, num_threads);
+
+    // Report the pairs of logical nets in alphabetical order.
+    std::set<std::pair<std::string, std::string>> reported;
+    for (size_t i = 0; i < groups.size(); i++) {
+        if (!too_close[i]) continue;
+        for (const auto &name_a : net_names[groups[i].first.first]) {
+            for (const auto &name_b : net_names[groups[i].first.second]) {
+                if (name_a == name_b) continue;
+                reported.insert(std::minmax(name_a, name_b));
+            }
+        }
+    }
+    for (const auto &pair : reported) {
+        auto violation = make_violation(ViolationType::CLEARANCE);
+        violation.net = pair.first;
+        violation.other_net = pair.second;
+        violations.push_back(std::move(violation));
+    }
+    return violations;
+}
 
+/**
+ * Runs the design-rule check and returns the violations. The checks use
+ * up to num_threads threads (0 for the hardware concurrency), but the
+ * result is ordered deterministically: violations
+ * detected while building come first, followed by open circuits, short
+ * circuits, clearance violations, and annular ring violations. If
+ * anything is returned, the DRC failed.
+ */
+std::vector<Violation> Netlist::check(coord::CInt annular_ring, size_t num_threads) const {
+
+    // Each check writes to its own buffer, so they need no synchronization.
+    // The two cheap checks run side by side; the clearance and annular ring
+    // checks are parallel themselves, so they run one after the other, each
+    // with the full thread budget.
+    std::vector<Violation> open_circuits, short_circuits, clearance_violations, annular_ring_violations;
+    const std::function<void()> checks[] = {
+        [&] { open_circuits = check_open_circuits(logical_nets); },
+        [&] { short_circuits = check_net_pairs(connected_netlist, ViolationType::SHORT_CIRCUIT); }
+    };
+    parallel::for_each(sizeof(checks) / sizeof(checks[0]), [&checks](size_t i) {
+        checks[i]();
+    }, std::min<size_t>(2, parallel::get_num_threads(num_threads)));
+    clearance_violations = check_clearance(connected_netlist, clearance, num_threads);
+    annular_ring_violations = check_annular_rings(connected_netlist, annular_ring, num_threads);
+
+    // Concatenate the buffers in a fixed order. Nets that are short-circuited
+    // also violate clearance, but are only reported as a short.
+    std::set<std::pair<std::string, std::string>> shorted;
+    for (const auto &violation : short_circuits) {
+        shorted.insert({violation.net, violation.other_net});
+    }
+    auto violations = builder_violations;
+    violations.insert(violations.end(), open_circuits.begin(), open_circuits.end());
+    violations.insert(violations.end(), short_circuits.begin(), short_circuits.end());
+    for (auto &violation : clearance_violations) {
+        if (!shorted.count({violation.net, violation.other_net})) {
+            violations.push_back(std::move(violation));
+        }
+    }
+    violations.insert(violations.end(), annular_ring_violations.begin(), annular_ring_violations.end());
     return violations;
 }
 
+/**
+ * Runs the design-rule check. A list of violation messages is returned. If
+ * any message is returned, the DRC failed.
+ */
+std::list<std::string> Netlist::perform_drc(coord::CInt annular_ring) const {
+    std::list<std::string> messages;
+    for (const auto &violation : check(annular_ring)) {
+        messages.push_back(violation.to_string());
+    }
+    return messages;
+}
+
 /**
  * Returns the physical nets in the netlist. That is, the pieces of
  * connected copper and their shape, as well as references to the logical
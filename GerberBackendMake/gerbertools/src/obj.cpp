@@ -26,7 +26,9 @@
  * Contains tools for writing Wavefront OBJ and MTL files.
  */
 
+#define _USE_MATH_DEFINES
 #include <fstream>
+#include <cmath>
 #include <limits>
 #include <algorithm>
 #include "obj.hpp"
@@ -257,8 +259,38 @@ Object &ObjFile::add_object(const std::string &name, const std::string &material
  * Writes the contained OBJ file data to a file.
  */
 void ObjFile::to_file(std::ostringstream& stream) const {
+    size_t vertex_base = 0;
+    size_t uv_base = 0;
+    to_file(stream, {}, vertex_base, uv_base, "");
+}
+
+/**
+ * Writes a placed copy of the contained OBJ file data to a stream that may
+ * already contain other data. vertex_base and uv_base are the number of
+ * vertices and texture coordinates written to the stream before, and are
+ * updated accordingly. Object names are prefixed with name_prefix. This
+ * allows one ObjFile to be emitted many times without rebuilding it.
+ */
+void ObjFile::to_file(
+    std::ostringstream& stream,
+    const Placement &placement,
+    size_t &vertex_base,
+    size_t &uv_base,
+    const std::string &name_prefix
+) const {
+    bool transform = placement.x != 0.0 || placement.y != 0.0 || placement.rotation != 0.0;
+    double c = std::cos(placement.rotation * M_PI / 180.0);
+    double s = std::sin(placement.rotation * M_PI / 180.0);
+    size_t num_vertices = 0;
     for (const auto& vertex : vertices) {
-        stream << "v " << vertex.at(0) << " " << vertex.at(1) << " " << vertex.at(2) << "\n";
+        if (transform) {
+            double x = vertex.at(0) * c - vertex.at(1) * s + placement.x;
+            double y = vertex.at(0) * s + vertex.at(1) * c + placement.y;
+            stream << "v " << x << " " << y << " " << vertex.at(2) << "\n";
+        } else {
+            stream << "v " << vertex.at(0) << " " << vertex.at(1) << " " << vertex.at(2) << "\n";
+        }
+        num_vertices++;
     }
     double u_min = std::numeric_limits<double>::infinity();
     double u_max = -std::numeric_limits<double>::infinity();
@@ -272,21 +304,24 @@ void ObjFile::to_file(std::ostringstream& stream) const {
     }
     double u_scale = 1.0 / (u_max - u_min);
     double v_scale = 1.0 / (v_max - v_min);
+    size_t num_uvs = 0;
     for (const auto& uv : uv_coordinates) {
         stream << "vt " << (uv.at(0) - u_min) * u_scale << " " << (uv.at(1) - v_min) * v_scale << "\n";
+        num_uvs++;
     }
     for (const auto& object : objects) {
-        stream << "g " << object.get_name() << "\n";
+        stream << "g " << name_prefix << object.get_name() << "\n";
         stream << "usemtl " << object.get_material() << "\n";
         for (const auto& face : object.get_faces()) {
             stream << "f";
             for (const auto& corner : face) {
-                stream << " " << corner.get_vertex_index() << "/" << corner.get_uv_coordinate_index();
+                stream << " " << corner.get_vertex_index() + vertex_base << "/" << corner.get_uv_coordinate_index() + uv_base;
             }
             stream << "\n";
         }
     }
-
+    vertex_base += num_vertices;
+    uv_base += num_uvs;
 }
 
 } // namespace obj
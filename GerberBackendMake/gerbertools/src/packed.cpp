@@ -0,0 +1,135 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a compressed in-memory representation for sets of paths, used to
+ * keep cached geometry small while it is not being operated on.
+ */
+
+#include "packed.hpp"
+#include <limits>
+#include <stdexcept>
+
+namespace gerbertools {
+namespace packed {
+
+/**
+ * Appends a zigzag-encoded signed varint to the given buffer.
+ */
+static void put_svarint(std::vector<uint8_t> &data, coord::CInt value) {
+    auto v = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    while (v >= 0x80) {
+        data.push_back(static_cast<uint8_t>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(v));
+}
+
+/**
+ * Reads a zigzag-encoded signed varint from the given position, advancing it.
+ * The data is trusted, as it was produced by put_svarint().
+ */
+static coord::CInt get_svarint(const uint8_t *&p) {
+    uint64_t v = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = *p++;
+        v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return static_cast<coord::CInt>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+/**
+ * Packs the given paths.
+ */
+PackedPaths::PackedPaths(const coord::Paths &paths) {
+    headers.reserve(paths.size());
+    for (const auto &path : paths) {
+        if (path.size() > std::numeric_limits<uint32_t>::max()
+            || data.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("too much geometry to pack");
+        }
+        PathHeader header;
+        header.origin = path.empty() ? coord::CPt(0, 0) : path.front();
+        header.num_vertices = static_cast<uint32_t>(path.size());
+        header.offset = static_cast<uint32_t>(data.size());
+        for (size_t i = 1; i < path.size(); i++) {
+            put_svarint(data, path[i].X - path[i - 1].X);
+            put_svarint(data, path[i].Y - path[i - 1].Y);
+        }
+        headers.push_back(header);
+        num_vertices += path.size();
+    }
+    data.shrink_to_fit();
+}
+
+/**
+ * Expands the packed paths.
+ */
+coord::Paths PackedPaths::unpack() const {
+    coord::Paths paths(headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        const auto &header = headers[i];
+        auto &path = paths[i];
+        if (!header.num_vertices) {
+            continue;
+        }
+        path.resize(header.num_vertices);
+        auto pt = header.origin;
+        path[0] = pt;
+        const uint8_t *p = data.data() + header.offset;
+        for (uint32_t j = 1; j < header.num_vertices; j++) {
+            pt.X += get_svarint(p);
+            pt.Y += get_svarint(p);
+            path[j] = pt;
+        }
+    }
+    return paths;
+}
+
+/**
+ * Returns the number of paths.
+ */
+size_t PackedPaths::get_num_paths() const {
+    return headers.size();
+}
+
+/**
+ * Returns the total number of vertices.
+ */
+size_t PackedPaths::get_num_vertices() const {
+    return num_vertices;
+}
+
+/**
+ * Returns the approximate memory footprint in bytes.
+ */
+size_t PackedPaths::get_memory_usage() const {
+    return sizeof(PackedPaths) + headers.capacity() * sizeof(PathHeader) + data.capacity();
+}
+
+} // namespace packed
+} // namespace gerbertools
@@ -0,0 +1,367 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains the Panel class, which lays out copies of one or more circuit
+ * boards on a production panel.
+ */
+
+#define _USE_MATH_DEFINES
+#include "panel.hpp"
+#include "path.hpp"
+#include "obj.hpp"
+#include "svg.hpp"
+#include <cmath>
+#include <stdexcept>
+
+namespace gerbertools {
+namespace panel {
+
+/**
+ * Rotates the given point counterclockwise about the origin by the given
+ * number of degrees, and then translates it by the given offset.
+ */
+static coord::CPt transform(coord::CPt point, coord::CPt offset, double rotation) {
+    double c = std::cos(rotation * M_PI / 180.0);
+    double s = std::sin(rotation * M_PI / 180.0);
+    return {
+        static_cast<coord::CInt>(std::llround(point.X * c - point.Y * s)) + offset.X,
+        static_cast<coord::CInt>(std::llround(point.X * s + point.Y * c)) + offset.Y
+    };
+}
+
+/**
+ * Returns the bounds of the given board after rotating and translating it.
+ */
+static coord::CRect transformed_bounds(const pcb::CircuitBoard &board, coord::CPt offset, double rotation) {
+    auto bounds = board.get_bounds();
+    coord::CRect result;
+    result.left = result.bottom = INT64_MAX;
+    result.right = result.top = INT64_MIN;
+    for (auto corner : {
+        coord::CPt(bounds.left, bounds.bottom),
+        coord::CPt(bounds.right, bounds.bottom),
+        coord::CPt(bounds.right, bounds.top),
+        coord::CPt(bounds.left, bounds.top)
+    }) {
+        auto pt = transform(corner, offset, rotation);
+        result.left = std::min(result.left, pt.X);
+        result.right = std::max(result.right, pt.X);
+        result.bottom = std::min(result.bottom, pt.Y);
+        result.top = std::max(result.top, pt.Y);
+    }
+    return result;
+}
+
+/**
+ * Grows the first rectangle to include the second.
+ */
+static void include(coord::CRect &bounds, const coord::CRect &other) {
+    bounds.left = std::min(bounds.left, other.left);
+    bounds.right = std::max(bounds.right, other.right);
+    bounds.bottom = std::min(bounds.bottom, other.bottom);
+    bounds.top = std::max(bounds.top, other.top);
+}
+
+/**
+ * Adds a board that can then be placed on the panel. Returns its index.
+ */
+size_t Panel::add_board(std::shared_ptr<const pcb::CircuitBoard> board) {
+    boards.push_back(std::move(board));
+    return boards.size() - 1;
+}
+
+/**
+ * Places a copy of the given board at the given offset, rotated
+ * counterclockwise about its origin by the given number of degrees.
+ */
+void Panel::place(size_t board, coord::CPt offset, double rotation) {
+    if (board >= boards.size()) {
+        throw std::out_of_range("board index out of range");
+    }
+    instances.push_back({board, offset, rotation});
+}
+
+/**
+ * Places copies of the given board in a grid of the given size, with the
+ * given spacing between the boards. Returns the index of the board.
+ */
+size_t Panel::place_grid(
+    std::shared_ptr<const pcb::CircuitBoard> board,
+    size_t columns,
+    size_t rows,
+    coord::CInt spacing,
+    double rotation
+) {
+    auto bounds = transformed_bounds(*board, {0, 0}, rotation);
+    auto pitch_x = bounds.right - bounds.left + spacing;
+    auto pitch_y = bounds.top - bounds.bottom + spacing;
+    auto index = add_board(std::move(board));
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t column = 0; column < columns; column++) {
+            place(index, {
+                static_cast<coord::CInt>(column) * pitch_x - bounds.left,
+                static_cast<coord::CInt>(row) * pitch_y - bounds.bottom
+            }, rotation);
+        }
+    }
+    return index;
+}
+
+/**
+ * Adds rails of the given width along the top and bottom of the placed
+ * boards, leaving the given gap between the boards and the rails.
+ */
+void Panel::add_rails(coord::CInt width, coord::CInt gap) {
+    auto bounds = get_board_bounds();
+    if (bounds.left > bounds.right) {
+        throw std::logic_error("cannot add rails to a panel without boards");
+    }
+    auto rect = [](coord::CInt x1, coord::CInt y1, coord::CInt x2, coord::CInt y2) {
+        return coord::Path({{x1, y1}, {x2, y1}, {x2, y2}, {x1, y2}});
+    };
+    frame = path::add(frame, {
+        rect(bounds.left, bounds.top + gap, bounds.right, bounds.top + gap + width),
+        rect(bounds.left, bounds.bottom - gap - width, bounds.right, bounds.bottom - gap)
+    });
+}
+
+/**
+ * Adds a breakaway tab of the given width to the frame, running straight
+ * from one given point to the other. Tabs are meant to bridge the gap
+ * between two boards or between a board and a rail.
+ */
+void Panel::add_tab(coord::CPt from, coord::CPt to, coord::CInt width) {
+    if (width <= 0) {
+        throw std::invalid_argument("tab width must be positive");
+    }
+    double dx = static_cast<double>(to.X - from.X);
+    double dy = static_cast<double>(to.Y - from.Y);
+    double length = std::hypot(dx, dy);
+    if (length == 0.0) {
+        throw std::invalid_argument("tab must have a nonzero length");
+    }
+
+    // Offset both ends sideways by half the width.
+    auto nx = static_cast<coord::CInt>(std::llround(-dy / length * width / 2));
+    auto ny = static_cast<coord::CInt>(std::llround(dx / length * width / 2));
+    coord::Path tab = {
+        {from.X - nx, from.Y - ny},
+        {to.X - nx, to.Y - ny},
+        {to.X + nx, to.Y + ny},
+        {from.X + nx, from.Y + ny}
+    };
+    if (!ClipperLib::Orientation(tab)) {
+        ClipperLib::ReversePath(tab);
+    }
+    frame = path::add(frame, {tab});
+}
+
+/**
+ * Adds a V-score line between the given points.
+ */
+void Panel::add_vscore(coord::CPt from, coord::CPt to) {
+    vscores.emplace_back(from, to);
+}
+
+/**
+ * Adds a row of mouse bite holes of the given diameter between the given
+ * points, at the given pitch. The holes are cut out of the frame, so they
+ * only show where they cross a rail or a tab.
+ */
+void Panel::add_mouse_bites(coord::CPt from, coord::CPt to, coord::CInt diameter, coord::CInt pitch) {
+    if (pitch <= 0) {
+        throw std::invalid_argument("mouse bite pitch must be positive");
+    }
+    double dx = static_cast<double>(to.X - from.X);
+    double dy = static_cast<double>(to.Y - from.Y);
+    auto count = static_cast<size_t>(std::floor(std::hypot(dx, dy) / pitch)) + 1;
+    for (size_t i = 0; i < count; i++) {
+        double f = (count > 1) ? static_cast<double>(i) / (count - 1) : 0.0;
+        coord::CPt center(
+            from.X + static_cast<coord::CInt>(std::llround(dx * f)),
+            from.Y + static_cast<coord::CInt>(std::llround(dy * f))
+        );
+        mouse_bites.emplace_back(center, center, diameter, false);
+    }
+}
+
+/**
+ * Returns the placements of all boards.
+ */
+const std::vector<Instance> &Panel::get_instances() const {
+    return instances;
+}
+
+/**
+ * Returns the panel frame (rails and tabs), minus the mouse bites.
+ */
+coord::Paths Panel::get_frame() const {
+    if (mouse_bites.empty()) {
+        return frame;
+    }
+    return path::subtract(frame, ncdrill::render_holes(mouse_bites));
+}
+
+/**
+ * Returns the axis-aligned bounds of all placed boards.
+ */
+coord::CRect Panel::get_board_bounds() const {
+    coord::CRect bounds;
+    bounds.left = bounds.bottom = INT64_MAX;
+    bounds.right = bounds.top = INT64_MIN;
+    for (const auto &instance : instances) {
+        include(bounds, transformed_bounds(*boards[instance.board], instance.offset, instance.rotation));
+    }
+    return bounds;
+}
+
+/**
+ * Returns the axis-aligned bounds of the panel.
+ */
+coord::CRect Panel::get_bounds() const {
+    auto bounds = get_board_bounds();
+    for (const auto &path : frame) {
+        for (const auto &point : path) {
+            include(bounds, {point.X, point.Y, point.X, point.Y});
+        }
+    }
+    return bounds;
+}
+
+/**
+ * Renders the panel to an SVG. Every unique board is rendered once into the
+ * SVG definitions and referenced by each of its placements. Throws if the
+ * panel has neither boards nor a frame.
+ */
+void Panel::write_svg(
+    std::ostringstream &stream,
+    bool flipped,
+    double scale,
+    const pcb::ColorScheme &colors
+) const {
+    auto bounds = get_bounds();
+    if (bounds.left > bounds.right) {
+        throw std::logic_error("cannot render an empty panel");
+    }
+
+    auto width = bounds.right - bounds.left + coord::Format::from_mm(20.0);
+    auto height = bounds.top - bounds.bottom + coord::Format::from_mm(20.0);
+
+    stream << "<svg viewBox=\"0 0 " << coord::Format::to_mm(width) << " " << coord::Format::to_mm(height) << "\"";
+    stream << " width=\"" << coord::Format::to_mm(width) * scale << "\" height=\"" << coord::Format::to_mm(height) * scale << "\"";
+    stream << " xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n";
+
+    // Every board that is actually placed is rendered once.
+    std::vector<bool> used(boards.size(), false);
+    for (const auto &instance : instances) {
+        used[instance.board] = true;
+    }
+    stream << "<defs>\n";
+    for (size_t i = 0; i < boards.size(); i++) {
+        if (!used[i]) continue;
+        auto id = "board" + std::to_string(i);
+        stream << "<g id=\"" << id << "\">\n";
+        stream << boards[i]->get_svg(flipped, colors, id + "_");
+        stream << "</g>\n";
+    }
+    stream << "</defs>\n";
+
+    auto tx = coord::Format::from_mm(10.0) - (flipped ? -bounds.right : bounds.left);
+    auto ty = coord::Format::from_mm(10.0) + bounds.top;
+
+    stream << "<g transform=\"";
+    stream << "translate(" << coord::Format::to_mm(tx) << " " << coord::Format::to_mm(ty) << ") ";
+    stream << "scale(" << (flipped ? "-1" : "1") << " -1) ";
+    stream << "\" filter=\"drop-shadow(0 0 1 rgba(0, 0, 0, 0.2))\">\n";
+
+    svg::Layer frame_layer("frame");
+    frame_layer.add(get_frame(), colors.substrate);
+    stream << frame_layer;
+
+    for (const auto &instance : instances) {
+        stream << "<use xlink:href=\"#board" << instance.board << "\" transform=\"";
+        stream << "translate(" << coord::Format::to_mm(instance.offset.X) << " " << coord::Format::to_mm(instance.offset.Y) << ")";
+        if (instance.rotation != 0.0) {
+            stream << " rotate(" << instance.rotation << ")";
+        }
+        stream << "\"/>\n";
+    }
+
+    svg::Layer vscore_layer("vscore");
+    for (const auto &vscore : vscores) {
+        std::ostringstream line;
+        line << "<path stroke=\"rgb(0,0,0)\" stroke-width=\"0.2\" stroke-dasharray=\"1 1\" fill=\"none\" d=\"M ";
+        line << coord::Format::to_mm(vscore.first.X) << " " << coord::Format::to_mm(vscore.first.Y) << " L ";
+        line << coord::Format::to_mm(vscore.second.X) << " " << coord::Format::to_mm(vscore.second.Y) << "\"/>";
+        vscore_layer.add(line.str());
+    }
+    stream << vscore_layer;
+
+    stream << "</g>\n";
+    stream << "</svg>\n";
+}
+
+/**
+ * Renders the panel to a Wavefront OBJ file. The geometry of every unique
+ * board is built once and written out transformed for each placement.
+ */
+void Panel::write_obj(std::ostringstream &stream) const {
+    size_t vertex_base = 0;
+    size_t uv_base = 0;
+
+    double thickness = 0.0;
+    for (size_t i = 0; i < boards.size(); i++) {
+        std::vector<const Instance*> placed;
+        for (const auto &instance : instances) {
+            if (instance.board == i) {
+                placed.push_back(&instance);
+            }
+        }
+        if (placed.empty()) continue;
+        thickness = std::max(thickness, boards[i]->get_thickness());
+
+        // Only one board's geometry is held in memory at a time.
+        obj::ObjFile obj;
+        boards[i]->build_obj(obj);
+        for (size_t j = 0; j < placed.size(); j++) {
+            obj::Placement placement;
+            placement.x = coord::Format::to_mm(placed[j]->offset.X);
+            placement.y = coord::Format::to_mm(placed[j]->offset.Y);
+            placement.rotation = placed[j]->rotation;
+            auto prefix = "board" + std::to_string(i) + "_" + std::to_string(j) + "_";
+            obj.to_file(stream, placement, vertex_base, uv_base, prefix);
+        }
+    }
+
+    auto frame_paths = get_frame();
+    if (!frame_paths.empty()) {
+        obj::ObjFile obj;
+        obj.add_object("frame", "substrate").add_sheet(frame_paths, 0.0, thickness);
+        obj.to_file(stream, {}, vertex_base, uv_base, "");
+    }
+}
+
+} // namespace panel
+} // namespace gerbertools
@@ -0,0 +1,228 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains a small dependency-graph scheduler and parallel loop helper, used to
+ * spread independent geometry operations over all available cores.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "parallel.hpp"
+
+namespace gerbertools {
+namespace parallel {
+
+/**
+ * Returns the number of worker threads to use for the given request. Zero
+ * means all available cores.
+ */
+size_t get_num_threads(size_t requested) {
+    if (requested) {
+        return requested;
+    }
+    size_t n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+/**
+ * Adds a stage to the graph. The dependencies must have been added before.
+ * Returns an identifier that can be used as a dependency for later stages.
+ */
+StageId TaskGraph::add(const std::string &name, std::function<void()> fn, const std::vector<StageId> &dependencies) {
+    StageId id = stages.size();
+    for (auto dep : dependencies) {
+        if (dep >= id) {
+            throw std::logic_error("stage " + name + " depends on a stage that does not exist yet");
+        }
+        stages.at(dep).dependents.push_back(id);
+    }
+    stages.push_back({name, std::move(fn), {}, dependencies.size()});
+    return id;
+}
+
+/**
+ * Runs all stages using the given number of threads (zero for all
+ * available cores). If any stage throws, no further stages are started,
+ * and the first exception is rethrown once the running stages complete.
+ */
+void TaskGraph::run(size_t num_threads) {
+    using Clock = std::chrono::steady_clock;
+    auto epoch = Clock::now();
+    auto ms_since = [](Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    };
+
+    timings.clear();
+    timings.resize(stages.size());
+    std::vector<size_t> remaining(stages.size());
+    std::deque<StageId> ready;
+    for (StageId id = 0; id < stages.size(); id++) {
+        timings.at(id).name = stages.at(id).name;
+        remaining.at(id) = stages.at(id).num_dependencies;
+        if (!remaining.at(id)) {
+            ready.push_back(id);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t running = 0;
+    size_t completed = 0;
+    std::exception_ptr error;
+
+    // Each worker repeatedly takes a ready stage, runs it outside the lock,
+    // and then releases its dependents. Workers exit when everything is done,
+    // or when a stage failed and nothing is running anymore.
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cv.wait(lock, [&]() {
+                return !ready.empty() || completed == stages.size() || (error && !running);
+            });
+            if (ready.empty() || error) {
+                return;
+            }
+            auto id = ready.front();
+            ready.pop_front();
+            running++;
+            lock.unlock();
+
+            auto start = Clock::now();
+            std::exception_ptr stage_error;
+            try {
+                stages.at(id).fn();
+            } catch (...) {
+                stage_error = std::current_exception();
+            }
+            auto end = Clock::now();
+
+            lock.lock();
+            running--;
+            completed++;
+            timings.at(id).start_ms = ms_since(epoch, start);
+            timings.at(id).duration_ms = ms_since(start, end);
+            if (stage_error) {
+                if (!error) {
+                    error = stage_error;
+                }
+            } else {
+                for (auto dep : stages.at(id).dependents) {
+                    if (!--remaining.at(dep)) {
+                        ready.push_back(dep);
+                    }
+                }
+            }
+            cv.notify_all();
+        }
+    };
+
+    num_threads = std::min(get_num_threads(num_threads), stages.size());
+    if (num_threads <= 1) {
+        worker();
+    } else {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+        for (size_t i = 1; i < num_threads; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (completed != stages.size()) {
+        throw std::logic_error("task graph did not complete");
+    }
+}
+
+/**
+ * Returns the timing information for all stages of the last run.
+ */
+const std::vector<StageTiming> &TaskGraph::get_timings() const {
+    return timings;
+}
+
+/**
+ * Calls fn for every index in [0, count) using the given number of threads
+ * (zero for all available cores). If any call throws, the first exception is
+ * rethrown after all threads are done.
+ */
+void for_each(size_t count, const std::function<void(size_t)> &fn, size_t num_threads) {
+    num_threads = std::min(get_num_threads(num_threads), count);
+    if (num_threads <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::mutex mutex;
+    std::exception_ptr error;
+    auto worker = [&]() {
+        while (true) {
+            size_t i = next++;
+            if (i >= count) {
+                return;
+            }
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = count;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace parallel
+} // namespace gerbertools
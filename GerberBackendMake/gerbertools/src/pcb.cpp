@@ -29,14 +29,19 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
 #include "gerber.hpp"
 #include "pcb.hpp"
 #include "path.hpp"
+#include "hash.hpp"
+#include "snapshot.hpp"
+#include "memstream.hpp"
 #include <iostream>
 #include <stdexcept>
 #include <chrono>
 #include <string>
 #include <vector>
+#include <tuple>
 #include <filesystem>
 
 namespace gerbertools {
@@ -59,16 +64,84 @@ namespace gerbertools {
 			copper(copper)
 		{}
 
+		/**
+		 * Constructs a layer identifier.
+		 */
+		LayerId::LayerId(LayerRole role, size_t index) : role(role), index(index) {
+		}
+
+		/**
+		 * Returns the role of the layer.
+		 */
+		LayerRole LayerId::get_role() const {
+			return role;
+		}
+
+		/**
+		 * Returns the index of the layer.
+		 */
+		size_t LayerId::get_index() const {
+			return index;
+		}
+
+		/**
+		 * Returns whether this is a bottom-side layer.
+		 */
+		bool LayerId::is_bottom() const {
+			return role == LayerRole::BOTTOM_MASK
+				|| role == LayerRole::BOTTOM_SILK
+				|| role == LayerRole::BOTTOM_COPPER;
+		}
+
+		/**
+		 * Returns the identifier as a string, for example "copper_top",
+		 * "mask_bottom", "copper_inner1", or "substrate1".
+		 */
+		std::string LayerId::to_string() const {
+			switch (role) {
+				case LayerRole::BOTTOM_MASK: return "mask_bottom";
+				case LayerRole::BOTTOM_SILK: return "silk_bottom";
+				case LayerRole::BOTTOM_COPPER: return "copper_bottom";
+				case LayerRole::SUBSTRATE: return "substrate" + std::to_string(index);
+				case LayerRole::INNER_COPPER: return "copper_inner" + std::to_string(index);
+				case LayerRole::TOP_COPPER: return "copper_top";
+				case LayerRole::TOP_SILK: return "silk_top";
+				case LayerRole::TOP_MASK: return "mask_top";
+			}
+			throw std::logic_error("unknown layer role");
+		}
+
+		/**
+		 * Returns a stackup for the given number of copper layers, with 1oz
+		 * copper and a total dielectric thickness of 1.5mm divided equally.
+		 */
+		Stackup Stackup::standard(size_t num_copper_layers) {
+			if (num_copper_layers < 2) {
+				throw std::invalid_argument("a stackup needs at least two copper layers");
+			}
+			Stackup stackup;
+			stackup.copper.assign(num_copper_layers, COPPER_OZ);
+			stackup.dielectric.assign(num_copper_layers - 1, 1.5 / (num_copper_layers - 1));
+			return stackup;
+		}
+
 		/**
 		 * Constructs a layer.
 		 */
-		Layer::Layer(const std::string& name, double thickness) : name(name), thickness(thickness) {
+		Layer::Layer(const LayerId& id, double thickness) : id(id), name(id.to_string()), thickness(thickness) {
+		}
+
+		/**
+		 * Returns the identifier for the layer.
+		 */
+		const LayerId& Layer::get_id() const {
+			return id;
 		}
 
 		/**
 		 * Returns a name for the layer.
 		 */
-		std::string Layer::get_name() const {
+		const std::string& Layer::get_name() const {
 			return name;
 		}
 
@@ -79,25 +152,32 @@ namespace gerbertools {
 			return thickness;
 		}
 
+		/**
+		 * Computes all geometry of the layer that is otherwise computed on first
+		 * use.
+		 */
+		void Layer::finalize() const {
+		}
+
 
 
 		/**
 		 * Constructs a substrate layer.
 		 */
 		SubstrateLayer::SubstrateLayer(
-			const std::string& name,
-			const coord::Paths& shape,
-			const coord::Paths& dielectric,
-			const coord::Paths& plating,
+			const LayerId& id,
+			const coord::PathsRef& shape,
+			const coord::PathsRef& dielectric,
+			const coord::PathsRef& plating,
 			double thickness
-		) : Layer(name, thickness), shape(shape), dielectric(dielectric), plating(plating) {
+		) : Layer(id, thickness), shape(shape), dielectric(dielectric), plating(plating) {
 		}
 
 		/**
 		 * Returns the surface finish mask for this layer.
 		 */
-		coord::Paths SubstrateLayer::get_mask() const {
-			return dielectric;
+		const coord::Paths& SubstrateLayer::get_mask() const {
+			return *dielectric;
 		}
 
 		/**
@@ -105,8 +185,8 @@ namespace gerbertools {
 		 */
 		svg::Layer SubstrateLayer::to_svg(const ColorScheme& colors, bool flipped, const std::string& id_prefix) const {
 			auto layer = svg::Layer(id_prefix + get_name());
-			layer.add(dielectric, colors.substrate);
-			layer.add(plating, colors.finish);
+			layer.add(*dielectric, colors.substrate);
+			layer.add(*plating, colors.finish);
 			return layer;
 		}
 
@@ -118,7 +198,7 @@ namespace gerbertools {
 				"layer" + std::to_string(layer_index) + "_" + get_name(),
 				"substrate"
 			).add_sheet(
-				dielectric,
+				*dielectric,
 				z,
 				z + get_thickness()
 			);
@@ -128,29 +208,34 @@ namespace gerbertools {
 		 * Constructs a copper layer.
 		 */
 		CopperLayer::CopperLayer(
-			const std::string& name,
-			const coord::Paths& board_shape,
-			const coord::Paths& board_shape_excl_pth,
-			const coord::Paths& copper_layer,
-			double thickness
-		) : Layer(name, thickness) {
-			layer = copper_layer;
-			copper = path::intersect(board_shape, copper_layer);
-			copper_excl_pth = path::intersect(board_shape_excl_pth, copper_layer);
-		}
+			const LayerId& id,
+			const coord::PathsRef& board_shape,
+			const coord::PathsRef& board_shape_excl_pth,
+			const PathsSource& copper_layer,
+			double thickness,
+			const NetObjectsRef& net_objects
+		) :
+			Layer(id, thickness),
+			layer(copper_layer),
+			board_shape(board_shape),
+			board_shape_excl_pth(board_shape_excl_pth),
+			copper([this]() { return path::intersect(*this->board_shape, *layer.get()); }),
+			copper_excl_pth([this]() { return path::intersect(*this->board_shape_excl_pth, *layer.get()); }),
+			net_objects(net_objects)
+		{}
 
 		/**
 		 * Returns the surface finish mask for this layer.
 		 */
-		coord::Paths CopperLayer::get_mask() const {
-			return copper;
+		const coord::Paths& CopperLayer::get_mask() const {
+			return copper.get();
 		}
 
 		/**
 		 * Returns the copper for this layer.
 		 */
 		const coord::Paths& CopperLayer::get_copper() const {
-			return copper;
+			return copper.get();
 		}
 
 		/**
@@ -158,14 +243,22 @@ namespace gerbertools {
 		 * non-plated holes, not for plated holes. This is needed for annular ring DRC.
 		 */
 		const coord::Paths& CopperLayer::get_copper_excl_pth() const {
-			return copper_excl_pth;
+			return copper_excl_pth.get();
 		}
 
 		/**
 		 * Returns the original layer, without board outline intersection.
 		 */
 		const coord::Paths& CopperLayer::get_layer() const {
-			return layer;
+			return *layer.get();
+		}
+
+		/**
+		 * Returns the objects that were tagged with a net name via Gerber X2
+		 * attributes, or null if the Gerber file had none.
+		 */
+		const NetObjectsRef& CopperLayer::get_net_objects() const {
+			return net_objects;
 		}
 
 		/**
@@ -173,7 +266,7 @@ namespace gerbertools {
 		 */
 		svg::Layer CopperLayer::to_svg(const ColorScheme& colors, bool flipped, const std::string& id_prefix) const {
 			auto layer = svg::Layer(id_prefix + get_name());
-			layer.add(copper, colors.copper);
+			layer.add(copper.get(), colors.copper);
 			return layer;
 		}
 
@@ -185,25 +278,58 @@ namespace gerbertools {
 			// bit of connected copper gets its own object.
 		}
 
+		/**
+		 * Computes all geometry of the layer that is otherwise computed on first
+		 * use.
+		 */
+		void CopperLayer::finalize() const {
+			copper.get();
+			copper_excl_pth.get();
+		}
+
 		/**
 		 * Constructs a solder mask.
 		 */
 		MaskLayer::MaskLayer(
-			const std::string& name,
+			const LayerId& id,
 			const coord::Paths& board_outline,
 			const coord::Paths& mask_layer,
-			const coord::Paths& silk_layer,
-			bool bottom
-		) : Layer(name, 0.01), bottom(bottom) {
-			mask = path::subtract(board_outline, mask_layer);
-			silk = path::intersect(mask, silk_layer);
-		}
+			const PathsSource& silk_layer
+		) :
+			Layer(id, 0.01),
+			mask([mask = coord::share(path::subtract(board_outline, mask_layer))]() { return mask; }),
+			silk_layer(silk_layer),
+			silk([this]() { return path::intersect(*mask.get(), *this->silk_layer.get()); }),
+			bottom(id.is_bottom())
+		{}
+
+		/**
+		 * Constructs a solder mask from an already derived mask shape.
+		 */
+		MaskLayer::MaskLayer(
+			const LayerId& id,
+			const PathsSource& mask,
+			const PathsSource& silk_layer
+		) :
+			Layer(id, 0.01),
+			mask(mask),
+			silk_layer(silk_layer),
+			silk([this]() { return path::intersect(*this->mask.get(), *this->silk_layer.get()); }),
+			bottom(id.is_bottom())
+		{}
 
 		/**
 		 * Returns the surface finish mask for this layer.
 		 */
-		coord::Paths MaskLayer::get_mask() const {
-			return mask;
+		const coord::Paths& MaskLayer::get_mask() const {
+			return *mask.get();
+		}
+
+		/**
+		 * Returns the silkscreen layer as specified in the Gerber file.
+		 */
+		const coord::Paths& MaskLayer::get_silk_layer() const {
+			return *silk_layer.get();
 		}
 
 		/**
@@ -212,16 +338,24 @@ namespace gerbertools {
 		svg::Layer MaskLayer::to_svg(const ColorScheme& colors, bool flipped, const std::string& id_prefix) const {
 			auto layer = svg::Layer(id_prefix + get_name());
 			if (bottom == flipped) {
-				layer.add(mask, colors.soldermask);
-				layer.add(silk, colors.silkscreen);
+				layer.add(*mask.get(), colors.soldermask);
+				layer.add(silk.get(), colors.silkscreen);
 			}
 			else {
-				layer.add(silk, colors.silkscreen);
-				layer.add(mask, colors.soldermask);
+				layer.add(silk.get(), colors.silkscreen);
+				layer.add(*mask.get(), colors.soldermask);
 			}
 			return layer;
 		}
 
+		/**
+		 * Computes all geometry of the layer that is otherwise computed on first
+		 * use.
+		 */
+		void MaskLayer::finalize() const {
+			silk.get();
+		}
+
 		/**
 		 * Renders the layer to an OBJ file.
 		 */
@@ -250,7 +384,7 @@ namespace gerbertools {
 				"layer" + std::to_string(layer_index) + mask_name,
 				"soldermask"
 			).add_sheet(
-				mask,
+				*mask.get(),
 				mask_z1,
 				mask_z2
 			);
@@ -258,7 +392,7 @@ namespace gerbertools {
 				"layer" + std::to_string(layer_index) + silk_name,
 				"silkscreen"
 			).add_surface(
-				silk,
+				silk.get(),
 				silk_z
 			);
 		}
@@ -289,44 +423,61 @@ namespace gerbertools {
 		//	return paths;
 		//}
 
-		coord::Paths CircuitBoard::read_gerber(const std::string& fname, bool outline) {
-			if (fname.empty()) {
+		coord::Paths CircuitBoard::read_gerber(std::string_view data, bool outline) {
+			if (data.empty()) {
 				return {};
 			}
-			auto f = std::istringstream(fname);
+			auto f = memstream::ViewStream(data);
 			auto g = gerber::Gerber(f);
 			auto paths = outline ? g.get_outline_paths() : g.get_paths();
 			return paths;
 		}
 
 		/**
-		 * Reads an NC drill file.
+		 * Parses a Gerber file, keeping the objects that were tagged with a net
+		 * name along with the paths.
 		 */
-		void CircuitBoard::read_drill(const std::string& fname, bool plated, coord::Paths& pth, coord::Paths& npth) {
-			if (fname.empty()) {
-				return;
-			}
-			//std::cout << "reading drill file " << fname << "..." << std::endl;
-			auto f = read_file(fname);
-			auto d = ncdrill::NCDrill(f, plated);
-			auto l = d.get_paths(true, false);
-			if (pth.empty()) {
-				pth = l;
-			}
-			else {
-				pth.insert(pth.end(), l.begin(), l.end());
-				ClipperLib::SimplifyPolygons(pth);
+		ParsedGerber CircuitBoard::parse_gerber(std::string_view data, bool outline) {
+			if (data.empty()) {
+				return { coord::share({}), nullptr };
 			}
-			l = d.get_paths(false, true);
-			if (npth.empty()) {
-				npth = l;
+			auto f = memstream::ViewStream(data);
+			auto g = gerber::Gerber(f);
+			auto paths = outline ? g.get_outline_paths() : g.get_paths();
+			ParsedGerber parsed;
+			parsed.paths = coord::share(std::move(paths));
+			if (!g.get_net_objects().empty()) {
+				parsed.net_objects = std::make_shared<const std::vector<gerber::NetObject>>(g.get_net_objects());
 			}
-			else {
-				npth.insert(npth.end(), l.begin(), l.end());
-				ClipperLib::SimplifyPolygons(npth);
+			return parsed;
+		}
+
+		/**
+		 * Parses an NC drill file.
+		 */
+		ParsedDrill CircuitBoard::parse_drill(std::string_view data, bool plated) {
+			if (data.empty()) {
+				return {};
 			}
-			auto new_vias = d.get_vias();
-			vias.insert(vias.end(), new_vias.begin(), new_vias.end());
+			auto f = memstream::ViewStream(data);
+			auto d = ncdrill::NCDrill(f, plated);
+			return { d.get_holes(), d.get_vias() };
+		}
+
+		/**
+		 * Appends the holes and vias of a parsed drill file.
+		 */
+		void CircuitBoard::add_drill(const ParsedDrill& drill) {
+			holes.insert(holes.end(), drill.holes.begin(), drill.holes.end());
+			vias.insert(vias.end(), drill.vias.begin(), drill.vias.end());
+			named_netlist = std::make_shared<NamedNetlist>();
+		}
+
+		/**
+		 * Reads an NC drill file, appending its holes to the hole table.
+		 */
+		void CircuitBoard::read_drill(std::string_view data, bool plated) {
+			add_drill(parse_drill(data, plated));
 		}
 
 
@@ -387,43 +538,93 @@ namespace gerbertools {
 		) : num_substrate_layers(0), plating_thickness(coord::Format::from_mm(0.5 * COPPER_OZ)){
 
 			std::string outline_str(outline.begin(), outline.end());
-			board_outline = read_gerber(outline_str, true);
-			coord::Paths pth, npth;
-			path::append(board_outline, read_gerber("", true));
+			auto outline_paths = read_gerber(outline_str, true);
+			path::append(outline_paths, read_gerber("", true));
+			board_outline = coord::share(std::move(outline_paths));
 
 			for each (auto var in drill)
 			{
-				read_drill(var, true, pth, npth);
+				read_drill(var, true);
 				if (drill_nonplated.empty()) {
-					read_drill(var, false, pth, npth);
+					read_drill(var, false);
 				}
 			}
-			auto holes = path::add(pth, npth);
-			board_shape = path::subtract(board_outline, holes);
-			board_shape_excl_pth = path::subtract(board_outline, npth);
 
-			coord::Paths pth_drill = path::offset(pth, this->plating_thickness, true);
+			derive_board_shape();
+		}
+
+		/**
+		 * Constructs an empty circuit board, to be filled in by LoadPCB().
+		 */
+		CircuitBoard::CircuitBoard(double plating_thickness) :
+			board_outline(coord::share({})),
+			plating_thickness(coord::Format::from_mm(plating_thickness)),
+			num_substrate_layers(0)
+		{}
+
+		/**
+		 * Derives board_shape, board_shape_excl_pth, substrate_dielectric and
+		 * substrate_plating from the board outline and the hole table in one
+		 * go, reusing intermediate results between them.
+		 */
+		void CircuitBoard::derive_board_shape() {
+
+			// Polygonize the holes, now that all of them are known. The plated
+			// holes before plating are simply the same primitives with their
+			// diameter grown by the plating on either side, so there is no need
+			// to offset the polygonized holes.
+			auto pth = ncdrill::render_holes(holes, true, false);
+			auto npth = ncdrill::render_holes(holes, false, true);
+			auto pth_drill = ncdrill::render_holes(holes, true, false, plating_thickness);
+
+			// Every other shape is the outline minus the non-plated holes minus
+			// something else, so do that subtraction only once. The remaining
+			// subtractions then also operate on a smaller subject.
+			auto excl_pth = path::subtract(*board_outline, npth);
+			board_shape = coord::share(path::subtract(excl_pth, pth));
+			substrate_dielectric = coord::share(path::subtract(excl_pth, pth_drill));
+			substrate_plating = coord::share(path::subtract(pth_drill, pth));
+			board_shape_excl_pth = coord::share(std::move(excl_pth));
+
+		}
 
-			substrate_dielectric = path::subtract(board_outline, path::add(pth_drill, npth));
-			substrate_plating = path::subtract(pth_drill, pth);
+		/**
+		 * Returns a source for paths that are already available.
+		 */
+		static PathsSource available(const coord::PathsRef& paths) {
+			return [paths]() { return paths; };
 		}
 
 		/**
-		 * Adds a mask layer to the board. Layers are added bottom-up.
+		 * Adds a mask layer to the board, given the contents of the mask and
+		 * silkscreen Gerber files. The role must be BOTTOM_MASK or TOP_MASK.
+		 * Layers are added bottom-up.
 		 */
-		void CircuitBoard::add_mask_layer(std::string& mask, const std::string& silk) {
+		void CircuitBoard::add_mask_layer(LayerRole role, std::string_view mask, std::string_view silk) {
+			if (role != LayerRole::BOTTOM_MASK && role != LayerRole::TOP_MASK) {
+				throw std::invalid_argument("mask layer must have a mask role");
+			}
 			layers.push_back(std::make_shared<MaskLayer>(
-				"mask" + mask, board_outline, read_gerber(mask), read_gerber(silk), layers.empty()
+				role, *board_outline, read_gerber(mask), available(coord::share(read_gerber(silk)))
 			));
+			named_netlist = std::make_shared<NamedNetlist>();
 		}
 
 		/**
-		 * Adds a copper layer to the board. Layers are added bottom-up.
+		 * Adds a copper layer to the board, given the contents of its Gerber
+		 * file. The role must be BOTTOM_COPPER, INNER_COPPER, or TOP_COPPER.
+		 * Layers are added bottom-up.
 		 */
-		void CircuitBoard::add_copper_layer(std::string& gerber, double thickness) {
+		void CircuitBoard::add_copper_layer(const LayerId& id, std::string_view gerber, double thickness) {
+			auto role = id.get_role();
+			if (role != LayerRole::BOTTOM_COPPER && role != LayerRole::INNER_COPPER && role != LayerRole::TOP_COPPER) {
+				throw std::invalid_argument("copper layer must have a copper role");
+			}
+			auto parsed = parse_gerber(gerber);
 			layers.push_back(std::make_shared<CopperLayer>(
-				"copper" + gerber, board_shape, board_shape_excl_pth, read_gerber(gerber), thickness
+				id, board_shape, board_shape_excl_pth, available(parsed.paths), thickness, parsed.net_objects
 			));
+			named_netlist = std::make_shared<NamedNetlist>();
 		}
 
 		/**
@@ -431,39 +632,50 @@ namespace gerbertools {
 		 */
 		void CircuitBoard::add_substrate_layer(double thickness) {
 			layers.push_back(std::make_shared<SubstrateLayer>(
-				"substrate" + std::to_string(++num_substrate_layers), board_shape, substrate_dielectric, substrate_plating, thickness
+				LayerId(LayerRole::SUBSTRATE, ++num_substrate_layers), board_shape, substrate_dielectric, substrate_plating, thickness
 			));
+			named_netlist = std::make_shared<NamedNetlist>();
 		}
 
 		/**
-		 * Derives the surface finish layer for all exposed copper.
+		 * Derives the surface finish for the first copper layer encountered when
+		 * walking the given range of layers, i.e. the copper not covered by any of
+		 * the layers before it.
 		 */
-		void CircuitBoard::add_surface_finish() {
+		template <typename It>
+		static coord::Paths derive_finish(It begin, It end) {
 			coord::Paths mask;
-			for (auto it = layers.begin(); it != layers.end(); ++it) {
+			for (auto it = begin; it != end; ++it) {
 				auto copper = std::dynamic_pointer_cast<CopperLayer>(*it);
 				if (copper) {
-					bottom_finish = path::subtract(copper->get_copper(), mask);
-					break;
-				}
-				mask = path::add(mask, (*it)->get_mask());
-			}
-			mask.clear();
-			for (auto it = layers.rbegin(); it != layers.rend(); ++it) {
-				auto copper = std::dynamic_pointer_cast<CopperLayer>(*it);
-				if (copper) {
-					top_finish = path::subtract(copper->get_copper(), mask);
-					break;
+					return path::subtract(copper->get_copper(), mask);
 				}
 				mask = path::add(mask, (*it)->get_mask());
 			}
+			return {};
+		}
+
+		/**
+		 * Derives the surface finish layer for all exposed copper. The finish is
+		 * computed on first use, for the layers added thus far.
+		 */
+		void CircuitBoard::add_surface_finish() {
+			auto stack = std::make_shared<const std::vector<LayerRef>>(layers.begin(), layers.end());
+			bottom_finish = std::make_shared<const Lazy<coord::Paths>>([stack]() {
+				return derive_finish(stack->begin(), stack->end());
+			});
+			top_finish = std::make_shared<const Lazy<coord::Paths>>([stack]() {
+				return derive_finish(stack->rbegin(), stack->rend());
+			});
 		}
 
 		/**
 		 * Returns a netlist builder initialized with the vias and copper regions of
-		 * this PCB.
+		 * this PCB. The copper is computed on the given number of threads (zero
+		 * for all available cores).
 		 */
-		netlist::NetlistBuilder CircuitBoard::get_netlist_builder() const {
+		netlist::NetlistBuilder CircuitBoard::get_netlist_builder(size_t num_threads) const {
+			prepare_copper(num_threads);
 			netlist::NetlistBuilder nb;
 			for (const auto& layer : layers) {
 				auto copper = std::dynamic_pointer_cast<CopperLayer>(layer);
@@ -478,9 +690,125 @@ namespace gerbertools {
 		}
 
 		/**
-		 * Returns the physical netlist for this PCB.
+		 * Returns whether any of the copper layers was tagged with net names
+		 * via Gerber X2 attributes.
 		 */
-		netlist::PhysicalNetlist CircuitBoard::get_physical_netlist() const {
+		bool CircuitBoard::has_net_attributes() const {
+			for (const auto& layer : layers) {
+				auto copper = std::dynamic_pointer_cast<CopperLayer>(layer);
+				if (copper && copper->get_net_objects()) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		 * Returns a netlist builder initialized as for get_netlist_builder(),
+		 * with a connection point for every flash and draw that was tagged with
+		 * a net name via Gerber X2 attributes. This yields the logical netlist
+		 * without an external netlist file, for design rule checks. Building it
+		 * resolves every tagged object; build_obj() only needs one name per
+		 * net and uses get_named_netlist() instead.
+		 */
+		netlist::NetlistBuilder CircuitBoard::get_attribute_netlist_builder(size_t num_threads) const {
+			auto nb = get_netlist_builder(num_threads);
+			std::vector<std::string> net_names;
+			std::map<std::string, uint32_t> net_indices;
+			std::vector<netlist::ConnectionRecord> records;
+			int layer_index = 0;
+			for (const auto& layer : layers) {
+				auto copper = std::dynamic_pointer_cast<CopperLayer>(layer);
+				if (!copper) {
+					continue;
+				}
+				if (const auto& objects = copper->get_net_objects()) {
+					for (const auto& object : *objects) {
+						auto index = net_indices.emplace(object.net, static_cast<uint32_t>(net_names.size())).first->second;
+						if (index == net_names.size()) {
+							net_names.push_back(object.net);
+						}
+						records.push_back({ object.coordinate, layer_index, index });
+					}
+				}
+				layer_index++;
+			}
+
+			// Tracks share their end points with each other and with pads, so many
+			// records are duplicates; each point only needs to be looked up once.
+			auto key = [](const netlist::ConnectionRecord& record) {
+				return std::make_tuple(record.layer, record.net, record.coordinate.X, record.coordinate.Y);
+			};
+			std::sort(records.begin(), records.end(), [&key](const auto& a, const auto& b) {
+				return key(a) < key(b);
+			});
+			records.erase(std::unique(records.begin(), records.end(), [&key](const auto& a, const auto& b) {
+				return key(a) == key(b);
+			}), records.end());
+
+			nb.add_connections(net_names, records);
+			return nb;
+		}
+
+		/**
+		 * Returns the physical netlist with each net named after a flash or
+		 * draw on it that was tagged with a net name via Gerber X2 attributes.
+		 * The result is cached; the copper is computed on the given number of
+		 * threads (zero for all available cores) when it is first needed.
+		 */
+		const NamedNetlist& CircuitBoard::get_named_netlist(size_t num_threads) const {
+			auto& named = *named_netlist;
+			std::call_once(named.once, [this, &named, num_threads]() {
+				named.netlist = get_physical_netlist(num_threads);
+				auto unnamed = named.netlist.get_arena().get_net_count();
+				named.names.assign(unnamed, "");
+
+				// Nearly every net has a pad, and pads are flashed, so the flashes
+				// are resolved first. The much more numerous draws are only
+				// resolved if some nets are left without a name, and each net is
+				// named after the first object found on it.
+				for (bool flash : { true, false }) {
+					if (!unnamed) {
+						break;
+					}
+					std::vector<coord::CPt> points;
+					std::vector<size_t> point_layers;
+					std::vector<const std::string*> point_nets;
+					size_t layer_index = 0;
+					for (const auto& layer : layers) {
+						auto copper = std::dynamic_pointer_cast<CopperLayer>(layer);
+						if (!copper) {
+							continue;
+						}
+						if (const auto& objects = copper->get_net_objects()) {
+							for (const auto& object : *objects) {
+								if (object.flash == flash) {
+									points.push_back(object.coordinate);
+									point_layers.push_back(layer_index);
+									point_nets.push_back(&object.net);
+								}
+							}
+						}
+						layer_index++;
+					}
+					auto nets = named.netlist.find_nets(points, point_layers, num_threads);
+					for (size_t i = 0; i < nets.size() && unnamed; i++) {
+						if (nets[i] != netlist::NO_NET && named.names[nets[i]].empty()) {
+							named.names[nets[i]] = *point_nets[i];
+							unnamed--;
+						}
+					}
+				}
+			});
+			return named;
+		}
+
+		/**
+		 * Returns the physical netlist for this PCB. The copper is computed on
+		 * the given number of threads (zero for all available cores).
+		 */
+		netlist::PhysicalNetlist CircuitBoard::get_physical_netlist(size_t num_threads) const {
+			prepare_copper(num_threads);
 			netlist::PhysicalNetlist pn;
 			size_t layer_index = 0;
 			for (const auto& layer : layers) {
@@ -491,7 +819,7 @@ namespace gerbertools {
 			}
 			for (const auto& via : vias) {
 				pn.register_via(
-					std::make_shared<netlist::Via>(
+					netlist::Via(
 						via.get_path(),
 						via.get_finished_hole_size(),
 						plating_thickness
@@ -499,9 +827,42 @@ namespace gerbertools {
 					layer_index
 				);
 			}
+			pn.finish();
 			return pn;
 		}
 
+		/**
+		 * Computes the board-clipped copper of all copper layers concurrently on
+		 * the given number of threads (zero for all available cores), ahead of
+		 * operations that need all of them.
+		 */
+		void CircuitBoard::prepare_copper(size_t num_threads) const {
+			std::vector<std::shared_ptr<CopperLayer>> copper_layers;
+			for (const auto& layer : layers) {
+				if (auto copper = std::dynamic_pointer_cast<CopperLayer>(layer)) {
+					copper_layers.push_back(copper);
+				}
+			}
+			parallel::for_each(copper_layers.size(), [&copper_layers](size_t i) {
+				copper_layers[i]->get_copper_excl_pth();
+			}, num_threads);
+		}
+
+		/**
+		 * Returns all drilled and routed holes as primitives.
+		 */
+		const ncdrill::HoleTable& CircuitBoard::get_holes() const {
+			return holes;
+		}
+
+		/**
+		 * Returns the per-stage timings of the task graph that built this
+		 * board. Empty if the board was not built by LoadPCB().
+		 */
+		const std::vector<parallel::StageTiming>& CircuitBoard::get_build_timings() const {
+			return build_timings;
+		}
+
 		/**
 		 * Returns the axis-aligned boundary coordinates of the PCB.
 		 */
@@ -509,7 +870,7 @@ namespace gerbertools {
 			coord::CRect bounds;
 			bounds.left = bounds.bottom = INT64_MAX;
 			bounds.right = bounds.top = INT64_MIN;
-			for (const auto& path : board_outline) {
+			for (const auto& path : *board_outline) {
 				for (const auto& point : path) {
 					bounds.left = std::min(bounds.left, point.X);
 					bounds.right = std::max(bounds.right, point.X);
@@ -522,24 +883,33 @@ namespace gerbertools {
 
 		/**
 		 * Renders the circuit board to SVG, returning only the body of it, allowing it
-		 * to be composited into a larger image.
+		 * to be composited into a larger image. The layers are rendered on the
+		 * given number of threads (zero for all available cores).
 		 */
-		std::string CircuitBoard::get_svg(bool flipped, const ColorScheme& colors, const std::string& id_prefix) const {
+		std::string CircuitBoard::get_svg(bool flipped, const ColorScheme& colors, const std::string& id_prefix, size_t num_threads) const {
 			std::ostringstream ss;
 
+			// Layers are rendered concurrently, and then concatenated in drawing
+			// order.
+			std::vector<LayerRef> order(layers.begin(), layers.end());
 			if (flipped) {
-				for (auto it = layers.rbegin(); it != layers.rend(); ++it) {
-					ss << (*it)->to_svg(colors, flipped, id_prefix);
-				}
+				std::reverse(order.begin(), order.end());
 			}
-			else {
-				for (auto it = layers.begin(); it != layers.end(); ++it) {
-					ss << (*it)->to_svg(colors, flipped, id_prefix);
-				}
+			std::vector<std::string> rendered(order.size());
+			parallel::for_each(order.size(), [&](size_t i) {
+				std::ostringstream layer;
+				layer << order[i]->to_svg(colors, flipped, id_prefix);
+				rendered[i] = layer.str();
+			}, num_threads);
+			for (const auto& layer : rendered) {
+				ss << layer;
 			}
 
 			auto finish = svg::Layer(id_prefix + "finish");
-			finish.add(flipped ? bottom_finish : top_finish, colors.finish);
+			const auto& finish_ref = flipped ? bottom_finish : top_finish;
+			if (finish_ref) {
+				finish.add(finish_ref->get(), colors.finish);
+			}
 			ss << finish;
 
 			return ss.str();
@@ -561,13 +931,15 @@ namespace gerbertools {
 		}
 
 		/**
-		 * Renders the circuit board to an SVG.
+		 * Renders the circuit board to an SVG, using the given number of threads
+		 * as for get_svg().
 		 */
 		void CircuitBoard::write_svg(
 			std::ostringstream& stream,
 			bool flipped,
 			double scale,
-			const ColorScheme& colors
+			const ColorScheme& colors,
+			size_t num_threads
 		) const {
 			auto bounds = get_bounds();
 
@@ -587,7 +959,7 @@ namespace gerbertools {
 			stream << "scale(" << (flipped ? "-1" : "1") << " -1) ";
 			stream << "\" filter=\"drop-shadow(0 0 1 rgba(0, 0, 0, 0.2))\">\n";
 
-			stream << get_svg(flipped, colors);
+			stream << get_svg(flipped, colors, "", num_threads);
 
 			stream << "</g>\n";
 			stream << "</svg>\n";
@@ -618,19 +990,25 @@ namespace gerbertools {
 		}
 
 		/**
-		 * Adds named copper shapes to the given Wavefront OBJ file manager.
+		 * Adds named copper shapes to the given Wavefront OBJ file manager. The
+		 * nets are named after the given names by net id if there are any, and
+		 * otherwise after their logical nets.
 		 */
 		static void render_copper(
 			obj::ObjFile& obj,
 			const netlist::PhysicalNetlist& netlist,
-			const std::vector<std::pair<double, double>>& copper_z
+			const std::vector<std::pair<double, double>>& copper_z,
+			const std::vector<std::string>& names = {}
 		) {
 			size_t name_counter = 1;
 			for (const auto& net : netlist.get_nets()) {
 
 				// Figure out a unique name for the copper object.
 				std::string name;
-				if (net->get_logical_nets().empty()) {
+				if (net->get_id() < names.size() && !names[net->get_id()].empty()) {
+					name = names[net->get_id()] + "_" + std::to_string(name_counter);
+				}
+				else if (net->get_logical_nets().empty()) {
 					name = "net_" + std::to_string(name_counter);
 				}
 				else {
@@ -650,10 +1028,10 @@ namespace gerbertools {
 				std::vector<Via> vias;
 				vias.reserve(net->get_vias().size());
 				for (const auto& via : net->get_vias()) {
-					auto center = via->get_coordinate();
-					auto diameter = via->get_finished_hole_size();
-					auto lower_layer = via->get_lower_layer(copper_z.size());
-					auto upper_layer = via->get_upper_layer(copper_z.size());
+					auto center = via.get_coordinate();
+					auto diameter = via.get_finished_hole_size();
+					auto lower_layer = via.get_lower_layer(copper_z.size());
+					auto upper_layer = via.get_upper_layer(copper_z.size());
 
 					// Render the inner ring. This goes all the way from the bottom of
 					// the lowest layer to the top of the upper layer.
@@ -665,7 +1043,7 @@ namespace gerbertools {
 					// connected by the via, from the top of the lower of the two layers
 					// to the bottom of the top of the two.
 					coord::Path outer;
-					render_circle(center, diameter + 2 * via->get_plating_thickness(), outer);
+					render_circle(center, diameter + 2 * via.get_plating_thickness(), outer);
 					for (size_t layer = lower_layer; layer < upper_layer; layer++) {
 						ob.add_ring(outer, copper_z.at(layer).second, copper_z.at(layer + 1).first);
 					}
@@ -680,16 +1058,16 @@ namespace gerbertools {
 
 				// Enumerate and render the planar copper shapes connected to this net.
 				for (const auto& shape : net->get_shapes()) {
-					auto zs = copper_z.at(shape->get_layer());
+					auto zs = copper_z.at(shape.get_layer());
 
 					// Add the rings.
-					ob.add_ring(shape->get_outline(), zs.first, zs.second);
-					for (const auto& path : shape->get_holes()) {
+					ob.add_ring(shape.get_outline(), zs.first, zs.second);
+					for (const auto& path : shape.get_holes()) {
 						ob.add_ring(path, zs.first, zs.second);
 					}
 
 					// Add the surfaces.
-					size_t layer = shape->get_layer();
+					size_t layer = shape.get_layer();
 					for (int side = 0; side < 2; side++) {
 
 						// Side 0 is the bottom of the sheet, side 1 is the top.
@@ -697,7 +1075,7 @@ namespace gerbertools {
 
 						// Figure out the holes in this shape, including those made by
 						// vias.
-						coord::Paths holes = shape->get_holes();
+						coord::Paths holes = shape.get_holes();
 						for (const auto& via : vias) {
 							if (layer < via.lower_layer) {
 								// Via is above this side/layer.
@@ -707,7 +1085,7 @@ namespace gerbertools {
 								// Via is below this side/layer.
 								continue;
 							}
-							if (!shape->contains(via.center)) {
+							if (!shape.contains(via.center)) {
 								// Via is in a different part of the PCB in-plane.
 								continue;
 							}
@@ -722,7 +1100,7 @@ namespace gerbertools {
 						}
 
 						// Add the copper surface.
-						ob.add_surface(shape->get_outline(), holes, z);
+						ob.add_surface(shape.get_outline(), holes, z);
 
 					}
 				}
@@ -732,10 +1110,22 @@ namespace gerbertools {
 		/**
 		 * Renders the circuit board to a Wavefront OBJ file. Optionally, a netlist
 		 * can be supplied, of which the logical net names will then be used to
-		 * name the copper objects.
+		 * name the copper objects. Without one, the names are taken from Gerber
+		 * X2 net attributes, if the copper layers have them. The copper is
+		 * computed on the given number of threads (zero for all available cores).
 		 */
-		void CircuitBoard::write_obj(std::ostringstream& stream, const netlist::Netlist* netlist) const {
+		void CircuitBoard::write_obj(std::ostringstream& stream, const netlist::Netlist* netlist, size_t num_threads) const {
 			obj::ObjFile obj;
+			build_obj(obj, netlist, num_threads);
+			obj.to_file(stream);
+		}
+
+		/**
+		 * Adds the 3D geometry of the circuit board to the given OBJ file, for
+		 * callers that write it out themselves. The netlist and thread count are
+		 * used as for write_obj().
+		 */
+		void CircuitBoard::build_obj(obj::ObjFile& obj, const netlist::Netlist* netlist, size_t num_threads) const {
 			double z = 0.0;
 			size_t index = 0;
 			std::vector<std::pair<double, double>> copper_z;
@@ -749,55 +1139,802 @@ namespace gerbertools {
 			if (netlist != nullptr) {
 				render_copper(obj, netlist->get_physical_netlist(), copper_z);
 			}
+			else if (has_net_attributes()) {
+				const auto& named = get_named_netlist(num_threads);
+				render_copper(obj, named.netlist, copper_z, named.names);
+			}
 			else {
-				render_copper(obj, get_physical_netlist(), copper_z);
+				render_copper(obj, get_physical_netlist(num_threads), copper_z);
 			}
-			obj.to_file(stream);
 		}
 
-		CircuitBoard CircuitBoard::LoadPCB(std::map<std::string, std::vector<std::string>>& files) {
-			std::string outline = files["outline"].front();
-			std::vector<std::string> drill= files["drill"];
+		/**
+		 * Returns the total thickness of the layer stack in millimeters.
+		 */
+		double CircuitBoard::get_thickness() const {
+			double thickness = 0.0;
+			for (const auto& layer : layers) {
+				thickness += layer->get_thickness();
+			}
+			return thickness;
+		}
 
-			std::string drill_nonplated;
-			drill_nonplated.push_back('\0');
-			std::string mill;
-			mill.push_back('\0');
-			double plating_thickness = 0.5 * pcb::COPPER_OZ;
+		/**
+		 * Produces the requested subset of outputs (a combination of
+		 * OutputFlags) from this board. The outputs are independent, so they
+		 * are generated concurrently on the given number of threads (zero for
+		 * all available cores). SVGs are rendered at the given scale.
+		 */
+		RenderedOutputs CircuitBoard::render(unsigned outputs, double svg_scale, size_t num_threads) const {
+			RenderedOutputs result;
+			parallel::TaskGraph graph;
+
+			// The SVG and OBJ stages are themselves parallel, so they split the
+			// thread budget between them rather than each using all of it.
+			size_t heavy_stages = 0;
+			for (auto output : { OUTPUT_FRONT_SVG, OUTPUT_BACK_SVG, OUTPUT_OBJ }) {
+				if (outputs & output) {
+					heavy_stages++;
+				}
+			}
+			auto share = std::max<size_t>(1, parallel::get_num_threads(num_threads) / std::max<size_t>(1, heavy_stages));
+
+			if (outputs & OUTPUT_FRONT_SVG) {
+				graph.add("front_svg", [this, &result, svg_scale, share]() {
+					std::ostringstream stream;
+					write_svg(stream, false, svg_scale, {}, share);
+					result.front_svg = stream.str();
+				});
+			}
+			if (outputs & OUTPUT_BACK_SVG) {
+				graph.add("back_svg", [this, &result, svg_scale, share]() {
+					std::ostringstream stream;
+					write_svg(stream, true, svg_scale, {}, share);
+					result.back_svg = stream.str();
+				});
+			}
+			if (outputs & OUTPUT_MTL) {
+				graph.add("mtl", [this, &result]() {
+					std::ostringstream stream;
+					generate_mtl_file(stream);
+					result.mtl = stream.str();
+				});
+			}
+			if (outputs & OUTPUT_OBJ) {
+				graph.add("obj", [this, &result, share]() {
+					std::ostringstream stream;
+					write_obj(stream, nullptr, share);
+					result.obj = stream.str();
+				});
+			}
+			graph.run(num_threads);
+			return result;
+		}
 
-			pcb::CircuitBoard board(outline, drill, drill_nonplated, mill, plating_thickness);
+		/**
+		 * Section tags used in board snapshots.
+		 */
+		enum SnapshotSection : uint32_t {
+			SNAPSHOT_META = 1,
+			SNAPSHOT_OUTLINE,
+			SNAPSHOT_SHAPE,
+			SNAPSHOT_SHAPE_EXCL_PTH,
+			SNAPSHOT_DIELECTRIC,
+			SNAPSHOT_PLATING,
+			SNAPSHOT_HOLES,
+			SNAPSHOT_VIAS,
+			SNAPSHOT_LAYER,
+			SNAPSHOT_NET_OBJECTS
+		};
 
-			if (!files["bottomMask"].empty()) {
-				auto bottomMask = files["bottomMask"].front();
-				auto bottomSilk = files["bottomSilk"].front();
-				board.add_mask_layer(bottomMask, bottomSilk);
+		/**
+		 * Layer types, as stored in snapshots and packed boards.
+		 */
+		enum StoredLayerType : unsigned {
+			STORED_SUBSTRATE_LAYER,
+			STORED_COPPER_LAYER,
+			STORED_MASK_LAYER
+		};
+
+		/**
+		 * Returns the stored type of the given layer.
+		 */
+		static StoredLayerType get_stored_type(const LayerRef& layer) {
+			if (std::dynamic_pointer_cast<CopperLayer>(layer)) {
+				return STORED_COPPER_LAYER;
+			} else if (std::dynamic_pointer_cast<MaskLayer>(layer)) {
+				return STORED_MASK_LAYER;
 			}
+			return STORED_SUBSTRATE_LAYER;
+		}
 
-			if (!files["bottomCopper"].empty()) {
-				auto bottomCopper = files["bottomCopper"].front();
-				board.add_copper_layer(bottomCopper, pcb::COPPER_OZ);
+		/**
+		 * Returns whether a layer of the given stored type may have the given
+		 * role.
+		 */
+		static bool is_stored_role(uint64_t type, LayerRole role) {
+			switch (type) {
+				case STORED_SUBSTRATE_LAYER:
+					return role == LayerRole::SUBSTRATE;
+				case STORED_COPPER_LAYER:
+					return role == LayerRole::BOTTOM_COPPER || role == LayerRole::INNER_COPPER || role == LayerRole::TOP_COPPER;
+				case STORED_MASK_LAYER:
+					return role == LayerRole::BOTTOM_MASK || role == LayerRole::TOP_MASK;
 			}
+			return false;
+		}
 
-			board.add_substrate_layer(1.5);
+		/**
+		 * Reconstructs a stored layer on top of this board's geometry. The paths
+		 * are the copper as drawn for copper layers, and the mask shape for mask
+		 * layers; silk is only used for mask layers. Neither is obtained from its
+		 * source until the layer needs it.
+		 */
+		LayerRef CircuitBoard::make_stored_layer(
+			unsigned type,
+			const LayerId& id,
+			double thickness,
+			const PathsSource& paths,
+			const PathsSource& silk,
+			const NetObjectsRef& net_objects
+		) const {
+			switch (type) {
+				case STORED_SUBSTRATE_LAYER:
+					return std::make_shared<SubstrateLayer>(
+						id, board_shape, substrate_dielectric, substrate_plating, thickness
+					);
+				case STORED_COPPER_LAYER:
+					return std::make_shared<CopperLayer>(
+						id, board_shape, board_shape_excl_pth, paths, thickness, net_objects
+					);
+				case STORED_MASK_LAYER:
+					return std::make_shared<MaskLayer>(
+						id, paths, silk
+					);
+			}
+			throw std::runtime_error("unknown stored layer type");
+		}
+
+		/**
+		 * Serializes the board to the binary snapshot format (see snapshot.hpp).
+		 * The snapshot contains the board geometry, holes, vias, layer stack,
+		 * and the objects that were tagged with a net name via Gerber X2
+		 * attributes; products that are computed on first use are not stored.
+		 */
+		std::string CircuitBoard::write_snapshot() const {
+			snapshot::Writer writer;
+
+			snapshot::Encoder meta;
+			meta.put_svarint(plating_thickness);
+			meta.put_varint(num_substrate_layers);
+			writer.add(SNAPSHOT_META, meta);
+
+			auto add_paths = [&writer](uint32_t tag, const coord::PathsRef& paths) {
+				snapshot::Encoder encoder;
+				encoder.put_paths(paths ? *paths : coord::Paths());
+				writer.add(tag, encoder);
+			};
+			add_paths(SNAPSHOT_OUTLINE, board_outline);
+			add_paths(SNAPSHOT_SHAPE, board_shape);
+			add_paths(SNAPSHOT_SHAPE_EXCL_PTH, board_shape_excl_pth);
+			add_paths(SNAPSHOT_DIELECTRIC, substrate_dielectric);
+			add_paths(SNAPSHOT_PLATING, substrate_plating);
+
+			snapshot::Encoder hole_data;
+			hole_data.put_varint(holes.size());
+			for (const auto& hole : holes) {
+				hole_data.put_path({ hole.get_start(), hole.get_end() });
+				hole_data.put_svarint(hole.get_diameter());
+				hole_data.put_varint(hole.is_plated());
+			}
+			writer.add(SNAPSHOT_HOLES, hole_data);
 
-			if (!files["topCopper"].empty()) {
-				auto topCopper = files["topCopper"].front();
-				board.add_copper_layer(topCopper, pcb::COPPER_OZ);
+			snapshot::Encoder via_data;
+			via_data.put_varint(vias.size());
+			for (const auto& via : vias) {
+				via_data.put_path(via.get_path());
+				via_data.put_svarint(via.get_finished_hole_size());
+			}
+			writer.add(SNAPSHOT_VIAS, via_data);
+
+			for (const auto& layer : layers) {
+				snapshot::Encoder encoder;
+				auto copper = std::dynamic_pointer_cast<CopperLayer>(layer);
+				auto mask = std::dynamic_pointer_cast<MaskLayer>(layer);
+				encoder.put_varint(get_stored_type(layer));
+				encoder.put_varint(static_cast<uint64_t>(layer->get_id().get_role()));
+				encoder.put_varint(layer->get_id().get_index());
+				encoder.put_double(layer->get_thickness());
+				if (copper) {
+					encoder.put_paths(copper->get_layer());
+				} else if (mask) {
+					encoder.put_paths(mask->get_mask());
+					encoder.put_paths(mask->get_silk_layer());
+				}
+				writer.add(SNAPSHOT_LAYER, encoder);
 			}
 
-			if (!files["topMask"].empty()) {
-				auto topMask = files["topMask"].front();
-				auto topSilk = files["topSilk"].front();
-				board.add_mask_layer(topMask, topSilk);
+			// The net objects of each copper layer are stored in a section of
+			// their own, referring to the layer by its index in the stack. Names
+			// repeat a lot, so they are stored once in a string table.
+			size_t layer_index = 0;
+			for (const auto& layer : layers) {
+				auto copper = std::dynamic_pointer_cast<CopperLayer>(layer);
+				const auto& objects = copper ? copper->get_net_objects() : nullptr;
+				if (objects && !objects->empty()) {
+					std::vector<std::string> strings;
+					std::map<std::string, uint64_t> string_ids;
+					auto intern = [&strings, &string_ids](const std::string& value) {
+						auto id = string_ids.emplace(value, strings.size()).first->second;
+						if (id == strings.size()) {
+							strings.push_back(value);
+						}
+						return id;
+					};
+					std::vector<uint64_t> ids;
+					coord::Path coordinates;
+					for (const auto& object : *objects) {
+						ids.push_back(intern(object.net));
+						ids.push_back(intern(object.reference));
+						ids.push_back(intern(object.pin));
+						coordinates.push_back(object.coordinate);
+					}
+					snapshot::Encoder encoder;
+					encoder.put_varint(layer_index);
+					encoder.put_varint(strings.size());
+					for (const auto& value : strings) {
+						encoder.put_string(value);
+					}
+					encoder.put_path(coordinates);
+					for (size_t i = 0; i < objects->size(); i++) {
+						encoder.put_varint(ids[3 * i]);
+						encoder.put_varint(ids[3 * i + 1]);
+						encoder.put_varint(ids[3 * i + 2]);
+						encoder.put_varint((*objects)[i].flash);
+					}
+					writer.add(SNAPSHOT_NET_OBJECTS, encoder);
+				}
+				layer_index++;
+			}
+
+			return writer.finish();
+		}
+
+		/**
+		 * Reconstructs a board from a snapshot produced by write_snapshot().
+		 * The data is only read during this call, so it may be mmapped.
+		 */
+		CircuitBoard CircuitBoard::read_snapshot(std::string_view data) {
+			snapshot::Reader reader(data);
+			CircuitBoard board(0.0);
+
+			snapshot::Decoder meta(reader.find(SNAPSHOT_META));
+			board.plating_thickness = meta.get_svarint();
+			board.num_substrate_layers = meta.get_varint();
+
+			auto get_paths = [&reader](uint32_t tag) {
+				return coord::share(snapshot::Decoder(reader.find(tag)).get_paths());
+			};
+			board.board_outline = get_paths(SNAPSHOT_OUTLINE);
+			board.board_shape = get_paths(SNAPSHOT_SHAPE);
+			board.board_shape_excl_pth = get_paths(SNAPSHOT_SHAPE_EXCL_PTH);
+			board.substrate_dielectric = get_paths(SNAPSHOT_DIELECTRIC);
+			board.substrate_plating = get_paths(SNAPSHOT_PLATING);
+
+			snapshot::Decoder hole_data(reader.find(SNAPSHOT_HOLES));
+			auto num_holes = hole_data.get_varint();
+			for (uint64_t i = 0; i < num_holes; i++) {
+				auto ends = hole_data.get_path();
+				if (ends.size() != 2) {
+					throw std::runtime_error("malformed hole in board snapshot");
+				}
+				auto diameter = hole_data.get_svarint();
+				auto plated = hole_data.get_varint() != 0;
+				board.holes.emplace_back(ends[0], ends[1], diameter, plated);
+			}
+
+			snapshot::Decoder via_data(reader.find(SNAPSHOT_VIAS));
+			auto num_vias = via_data.get_varint();
+			for (uint64_t i = 0; i < num_vias; i++) {
+				auto path = via_data.get_path();
+				auto size = via_data.get_svarint();
+				board.vias.emplace_back(std::move(path), size);
+			}
+
+			std::map<uint64_t, NetObjectsRef> net_objects;
+			for (auto section : reader.find_all(SNAPSHOT_NET_OBJECTS)) {
+				snapshot::Decoder decoder(section);
+				auto layer_index = decoder.get_varint();
+				std::vector<std::string> strings;
+				auto num_strings = decoder.get_varint();
+				for (uint64_t i = 0; i < num_strings; i++) {
+					strings.push_back(decoder.get_string());
+				}
+				auto get_string = [&decoder, &strings]() -> const std::string& {
+					auto id = decoder.get_varint();
+					if (id >= strings.size()) {
+						throw std::runtime_error("malformed net object in board snapshot");
+					}
+					return strings[id];
+				};
+				auto coordinates = decoder.get_path();
+				std::vector<gerber::NetObject> objects;
+				objects.reserve(coordinates.size());
+				for (const auto& coordinate : coordinates) {
+					gerber::NetObject object;
+					object.net = get_string();
+					object.reference = get_string();
+					object.pin = get_string();
+					object.coordinate = coordinate;
+					object.flash = decoder.get_varint() != 0;
+					objects.push_back(std::move(object));
+				}
+				if (!net_objects.emplace(layer_index, std::make_shared<const std::vector<gerber::NetObject>>(std::move(objects))).second) {
+					throw std::runtime_error("duplicate net objects in board snapshot");
+				}
+			}
+
+			for (auto section : reader.find_all(SNAPSHOT_LAYER)) {
+				snapshot::Decoder decoder(section);
+				auto type = decoder.get_varint();
+				auto role = decoder.get_varint();
+				if (role > static_cast<uint64_t>(LayerRole::TOP_MASK) || !is_stored_role(type, static_cast<LayerRole>(role))) {
+					throw std::runtime_error("malformed layer in board snapshot");
+				}
+				LayerId id(static_cast<LayerRole>(role), decoder.get_varint());
+				auto thickness = decoder.get_double();
+				coord::Paths paths, silk;
+				if (type == STORED_COPPER_LAYER || type == STORED_MASK_LAYER) {
+					paths = decoder.get_paths();
+				}
+				if (type == STORED_MASK_LAYER) {
+					silk = decoder.get_paths();
+				}
+				NetObjectsRef objects;
+				auto it = net_objects.find(board.layers.size());
+				if (it != net_objects.end() && type == STORED_COPPER_LAYER) {
+					objects = std::move(it->second);
+					net_objects.erase(it);
+				}
+				board.layers.push_back(board.make_stored_layer(
+					type, id, thickness, available(coord::share(std::move(paths))), available(coord::share(std::move(silk))), objects
+				));
+			}
+			if (!net_objects.empty()) {
+				throw std::runtime_error("net objects for a non-copper layer in board snapshot");
 			}
 
 			board.add_surface_finish();
+			return board;
+		}
+
+		/**
+		 * Converts the board to its compressed in-memory form. Products that are
+		 * computed on first use are not kept.
+		 */
+		PackedBoard CircuitBoard::pack() const {
+			PackedBoard packed;
+			packed.plating_thickness = plating_thickness;
+			packed.num_substrate_layers = num_substrate_layers;
+			packed.board_outline = packed::PackedPaths(*board_outline);
+			packed.board_shape = packed::PackedPaths(*board_shape);
+			packed.board_shape_excl_pth = packed::PackedPaths(*board_shape_excl_pth);
+			packed.substrate_dielectric = packed::PackedPaths(*substrate_dielectric);
+			packed.substrate_plating = packed::PackedPaths(*substrate_plating);
+			packed.holes = holes;
+			packed.vias = vias;
+			for (const auto& layer : layers) {
+				PackedBoard::StoredLayer stored{ get_stored_type(layer), layer->get_id(), layer->get_thickness(), {}, {}, nullptr };
+				if (auto copper = std::dynamic_pointer_cast<CopperLayer>(layer)) {
+					stored.paths = std::make_shared<const packed::PackedPaths>(copper->get_layer());
+					stored.net_objects = copper->get_net_objects();
+				} else if (auto mask = std::dynamic_pointer_cast<MaskLayer>(layer)) {
+					stored.paths = std::make_shared<const packed::PackedPaths>(mask->get_mask());
+					stored.silk = std::make_shared<const packed::PackedPaths>(mask->get_silk_layer());
+				}
+				packed.layers.push_back(std::move(stored));
+			}
+			return packed;
+		}
+
+		/**
+		 * Computes everything that is otherwise computed on first use, using the
+		 * given number of threads (zero for all available cores), and returns
+		 * the result as an immutable board. Rendering a frozen board only reads
+		 * from it, so a single instance can serve any number of concurrent
+		 * requests without locking or copying.
+		 */
+		std::shared_ptr<const CircuitBoard> CircuitBoard::freeze(size_t num_threads) const {
+			std::vector<LayerRef> all_layers(layers.begin(), layers.end());
+			parallel::for_each(all_layers.size(), [&all_layers](size_t i) {
+				all_layers[i]->finalize();
+			}, num_threads);
+
+			// The surface finish is derived from the layers, so it goes last.
+			std::vector<std::shared_ptr<const Lazy<coord::Paths>>> finishes;
+			for (const auto& finish : { bottom_finish, top_finish }) {
+				if (finish) {
+					finishes.push_back(finish);
+				}
+			}
+			parallel::for_each(finishes.size(), [&finishes](size_t i) {
+				finishes[i]->get();
+			}, num_threads);
+
+			return std::make_shared<const CircuitBoard>(*this);
+		}
+
+		/**
+		 * Returns the approximate memory footprint of the given net objects in
+		 * bytes.
+		 */
+		static size_t net_objects_cost(const std::vector<gerber::NetObject>& objects) {
+			size_t cost = sizeof(std::vector<gerber::NetObject>);
+			for (const auto& object : objects) {
+				cost += sizeof(gerber::NetObject) + object.net.size() + object.reference.size() + object.pin.size();
+			}
+			return cost;
+		}
+
+		/**
+		 * Returns the approximate memory footprint in bytes.
+		 */
+		size_t PackedBoard::get_memory_usage() const {
+			auto usage = sizeof(PackedBoard)
+				+ board_outline.get_memory_usage()
+				+ board_shape.get_memory_usage()
+				+ board_shape_excl_pth.get_memory_usage()
+				+ substrate_dielectric.get_memory_usage()
+				+ substrate_plating.get_memory_usage()
+				+ holes.capacity() * sizeof(ncdrill::Hole);
+			for (const auto& via : vias) {
+				usage += sizeof(ncdrill::Via) + via.get_path().size() * sizeof(coord::CPt);
+			}
+			for (const auto& layer : layers) {
+				usage += sizeof(StoredLayer);
+				if (layer.paths) {
+					usage += layer.paths->get_memory_usage();
+				}
+				if (layer.silk) {
+					usage += layer.silk->get_memory_usage();
+				}
+				if (layer.net_objects) {
+					usage += net_objects_cost(*layer.net_objects);
+				}
+			}
+			return usage;
+		}
+
+		/**
+		 * Returns a source that decodes the given packed paths when called. Null
+		 * packed paths decode to no paths.
+		 */
+		static PathsSource decode_on_use(const std::shared_ptr<const packed::PackedPaths>& packed) {
+			return [packed]() {
+				return coord::share(packed ? packed->unpack() : coord::Paths());
+			};
+		}
+
+		/**
+		 * Expands the board back into a CircuitBoard. The board geometry is
+		 * decoded concurrently on the given number of threads (zero for all
+		 * available cores); the geometry of each layer is only decoded when a
+		 * product first reads it.
+		 */
+		CircuitBoard PackedBoard::expand(size_t num_threads) const {
+			CircuitBoard board(0.0);
+			board.plating_thickness = plating_thickness;
+			board.num_substrate_layers = num_substrate_layers;
+			board.holes = holes;
+			board.vias = vias;
+
+			// The board geometry is needed by nearly every product, so it is decoded
+			// up front, in one parallel pass.
+			std::vector<const packed::PackedPaths*> sources = {
+				&board_outline, &board_shape, &board_shape_excl_pth, &substrate_dielectric, &substrate_plating
+			};
+			std::vector<coord::Paths> decoded(sources.size());
+			parallel::for_each(sources.size(), [&sources, &decoded](size_t i) {
+				decoded[i] = sources[i]->unpack();
+			}, num_threads);
+
+			board.board_outline = coord::share(std::move(decoded[0]));
+			board.board_shape = coord::share(std::move(decoded[1]));
+			board.board_shape_excl_pth = coord::share(std::move(decoded[2]));
+			board.substrate_dielectric = coord::share(std::move(decoded[3]));
+			board.substrate_plating = coord::share(std::move(decoded[4]));
+			for (const auto& layer : layers) {
+				board.layers.push_back(board.make_stored_layer(
+					layer.type, layer.id, layer.thickness, decode_on_use(layer.paths), decode_on_use(layer.silk), layer.net_objects
+				));
+			}
+
+			board.add_surface_finish();
+			return board;
+		}
+
+		/**
+		 * Returns views of all the file contents in the given map.
+		 */
+		static FileViews view_files(const std::map<std::string, std::vector<std::string>>& files) {
+			FileViews views;
+			for (const auto& file : files) {
+				views[file.first].assign(file.second.begin(), file.second.end());
+			}
+			return views;
+		}
+
+		/**
+		 * As LoadPCB() for file views, but for file contents held in strings.
+		 * The map is cleared afterwards.
+		 */
+		CircuitBoard CircuitBoard::LoadPCB(
+			std::map<std::string, std::vector<std::string>>& files,
+			size_t num_threads,
+			ParseCache* parse_cache,
+			const Stackup* stackup
+		) {
+			auto board = LoadPCB(view_files(files), num_threads, parse_cache, stackup);
 			files.clear();
+			return board;
+		}
+
+		/**
+		 * As LoadPCB() for file views, but takes ownership of the file contents,
+		 * which are released once the board has been built.
+		 */
+		CircuitBoard CircuitBoard::LoadPCB(
+			std::map<std::string, std::vector<std::string>>&& files,
+			size_t num_threads,
+			ParseCache* parse_cache,
+			const Stackup* stackup
+		) {
+			auto owned = std::move(files);
+			return LoadPCB(view_files(owned), num_threads, parse_cache, stackup);
+		}
+
+		/**
+		 * Builds a complete board from a map of file contents by role (outline,
+		 * drill, bottomMask, bottomSilk, bottomCopper, innerCopper, topCopper,
+		 * topMask, topSilk). innerCopper may hold any number of files, ordered
+		 * top-down. The stackup must have as many copper layers as there are
+		 * inner layers plus two; if none is given, the standard one is used.
+		 * The file contents are parsed in place, without being copied, so they
+		 * must stay alive until this returns. Once the files are known, the
+		 * build is a dependency graph: parsing of every file is independent, the
+		 * board shape depends on outline and drills, copper layers depend on the
+		 * board shape, masks only on outline, mask and silk, and the surface
+		 * finish on all of those. Independent stages run concurrently on the
+		 * given number of threads (zero for all available cores). If a parse
+		 * cache is given, only files that are not in it are parsed.
+		 */
+		CircuitBoard CircuitBoard::LoadPCB(
+			const FileViews& files,
+			size_t num_threads,
+			ParseCache* parse_cache,
+			const Stackup* stackup
+		) {
+			double plating_thickness = 0.5 * pcb::COPPER_OZ;
+			pcb::CircuitBoard board(plating_thickness);
+
+			// Look up the files up front, so the stages only deal with views.
+			static const std::vector<std::string_view> NONE;
+			auto files_for = [&files](const std::string& role) -> const std::vector<std::string_view>& {
+				auto it = files.find(role);
+				return it == files.end() ? NONE : it->second;
+			};
+			auto file_for = [&files_for](const std::string& role) -> const std::string_view* {
+				const auto& views = files_for(role);
+				return views.empty() ? nullptr : &views.front();
+			};
+			auto outline = file_for("outline");
+			if (!outline) {
+				throw std::runtime_error("missing board outline");
+			}
+			const auto& drill = files_for("drill");
+			const auto& inner = files_for("innerCopper");
+
+			// Copper layers are counted top-down: top, inner layers, bottom.
+			auto num_copper = inner.size() + 2;
+			auto layout = stackup ? *stackup : Stackup::standard(num_copper);
+			if (layout.copper.size() != num_copper || layout.dielectric.size() != num_copper - 1) {
+				throw std::invalid_argument(
+					"stackup does not match the number of copper layers (" + std::to_string(num_copper) + ")"
+				);
+			}
+
+			// Parses a Gerber file, going through the parse cache if there is one.
+			auto parse = [parse_cache](std::string_view data, bool outline) {
+				if (parse_cache) {
+					return parse_cache->get_gerber(data, outline);
+				}
+				return parse_gerber(data, outline);
+			};
+
+			parallel::TaskGraph graph;
+
+			// Board outline, drills, and the board shape derived from them.
+			auto outline_stage = graph.add("outline", [&board, outline, parse]() {
+				board.board_outline = parse(*outline, true).paths;
+			});
+			auto drill_stage = graph.add("drill", [&board, &drill, parse_cache]() {
+				for (const auto& var : drill) {
+					if (parse_cache) {
+						board.add_drill(*parse_cache->get_drill(var, true));
+					} else {
+						board.read_drill(var, true);
+					}
+				}
+			});
+			auto shape_stage = graph.add("board_shape", [&board]() {
+				board.derive_board_shape();
+			}, { outline_stage, drill_stage });
+
+			// Layers are built into fixed slots, ordered bottom-up, so they can be
+			// constructed out of order.
+			std::vector<LayerRef> slots;
+			std::vector<parallel::StageId> layer_stages;
+			std::list<ParsedGerber> parsed;
+
+			// Parses a Gerber file in its own stage, if it exists.
+			auto add_parse = [&](const std::string& name, const std::string_view* file, ParsedGerber*& result) {
+				result = &*parsed.emplace(parsed.end(), ParsedGerber{ coord::share({}), nullptr });
+				if (!file) {
+					return std::vector<parallel::StageId>();
+				}
+				auto gerber = result;
+				return std::vector<parallel::StageId>({ graph.add("parse_" + name, [gerber, file, parse]() {
+					*gerber = parse(*file, false);
+				}) });
+			};
+
+			// Adds a mask layer stage for the given mask and silk files.
+			auto add_mask = [&](LayerRole role, const std::string& mask_role, const std::string& silk_role) {
+				if (!file_for(mask_role)) {
+					return;
+				}
+				ParsedGerber* mask;
+				ParsedGerber* silk;
+				auto deps = add_parse(mask_role, file_for(mask_role), mask);
+				auto silk_deps = add_parse(silk_role, file_for(silk_role), silk);
+				deps.insert(deps.end(), silk_deps.begin(), silk_deps.end());
+				deps.push_back(outline_stage);
+				auto slot = slots.size();
+				slots.emplace_back();
+				LayerId id(role);
+				layer_stages.push_back(graph.add("layer_" + id.to_string(), [&board, &slots, slot, id, mask, silk]() {
+					slots.at(slot) = std::make_shared<MaskLayer>(
+						id, *board.board_outline, *mask->paths, available(silk->paths)
+					);
+				}, deps));
+			};
+
+			// Adds a copper layer stage for the given file.
+			auto add_copper = [&](const LayerId& id, const std::string_view* file, double thickness) {
+				if (!file) {
+					return;
+				}
+				ParsedGerber* copper;
+				auto deps = add_parse(id.to_string(), file, copper);
+				deps.push_back(shape_stage);
+				auto slot = slots.size();
+				slots.emplace_back();
+				layer_stages.push_back(graph.add("layer_" + id.to_string(), [&board, &slots, slot, id, copper, thickness]() {
+					slots.at(slot) = std::make_shared<CopperLayer>(
+						id, board.board_shape, board.board_shape_excl_pth, available(copper->paths), thickness, copper->net_objects
+					);
+				}, deps));
+			};
+
+			// Adds a substrate layer stage.
+			auto add_substrate = [&](double thickness) {
+				auto slot = slots.size();
+				slots.emplace_back();
+				LayerId id(LayerRole::SUBSTRATE, ++board.num_substrate_layers);
+				layer_stages.push_back(graph.add("layer_" + id.to_string(), [&board, &slots, slot, id, thickness]() {
+					slots.at(slot) = std::make_shared<SubstrateLayer>(
+						id, board.board_shape, board.substrate_dielectric, board.substrate_plating, thickness
+					);
+				}, { shape_stage }));
+			};
+
+			// Layers are added bottom-up.
+			add_mask(LayerRole::BOTTOM_MASK, "bottomMask", "bottomSilk");
+			add_copper(LayerRole::BOTTOM_COPPER, file_for("bottomCopper"), layout.copper.back());
+			for (size_t i = num_copper - 1; i-- > 1; ) {
+				add_substrate(layout.dielectric.at(i));
+				add_copper(LayerId(LayerRole::INNER_COPPER, i), &inner.at(i - 1), layout.copper.at(i));
+			}
+			add_substrate(layout.dielectric.front());
+			add_copper(LayerRole::TOP_COPPER, file_for("topCopper"), layout.copper.front());
+			add_mask(LayerRole::TOP_MASK, "topMask", "topSilk");
+
+			// The surface finish depends on all copper and masks.
+			graph.add("surface_finish", [&board, &slots]() {
+				board.layers.insert(board.layers.end(), slots.begin(), slots.end());
+				board.add_surface_finish();
+			}, layer_stages);
 
+			graph.run(num_threads);
+			board.build_timings = graph.get_timings();
 
 			return board;
 		}
 
+		/**
+		 * Returns the approximate memory footprint of the given paths in bytes.
+		 */
+		static size_t paths_cost(const coord::Paths& paths) {
+			size_t cost = sizeof(coord::Paths);
+			for (const auto& path : paths) {
+				cost += sizeof(coord::Path) + path.size() * sizeof(coord::CPt);
+			}
+			return cost;
+		}
+
+		/**
+		 * Constructs a parse cache with the given memory budget in bytes.
+		 */
+		ParseCache::ParseCache(size_t budget) : entries(budget) {
+		}
+
+		/**
+		 * Returns the paths and net-tagged objects for the given Gerber file,
+		 * parsing it if needed.
+		 */
+		ParsedGerber ParseCache::get_gerber(std::string_view data, bool outline) {
+			auto key = hash::Hasher().add(std::string_view("gerber")).add(static_cast<uint64_t>(outline)).add(data).digest();
+			if (auto entry = entries.get(key)) {
+				return entry->gerber;
+			}
+			auto gerber = CircuitBoard::parse_gerber(data, outline);
+			auto cost = paths_cost(*gerber.paths);
+			if (gerber.net_objects) {
+				cost += net_objects_cost(*gerber.net_objects);
+			}
+			entries.put(key, { gerber, nullptr }, cost);
+			return gerber;
+		}
+
+		/**
+		 * Returns the holes and vias for the given NC drill file, parsing it if
+		 * needed.
+		 */
+		std::shared_ptr<const ParsedDrill> ParseCache::get_drill(std::string_view data, bool plated) {
+			auto key = hash::Hasher().add(std::string_view("drill")).add(static_cast<uint64_t>(plated)).add(data).digest();
+			if (auto entry = entries.get(key)) {
+				return entry->drill;
+			}
+			auto drill = std::make_shared<const ParsedDrill>(CircuitBoard::parse_drill(data, plated));
+			size_t cost = sizeof(ParsedDrill) + drill->holes.size() * sizeof(ncdrill::Hole);
+			for (const auto& via : drill->vias) {
+				cost += sizeof(ncdrill::Via) + via.get_path().size() * sizeof(coord::CPt);
+			}
+			entries.put(key, { {}, drill }, cost);
+			return drill;
+		}
+
+		/**
+		 * Changes the memory budget, evicting entries as needed.
+		 */
+		void ParseCache::set_budget(size_t budget) {
+			entries.set_budget(budget);
+		}
+
+		/**
+		 * Removes all entries.
+		 */
+		void ParseCache::clear() {
+			entries.clear();
+		}
+
+		/**
+		 * Returns the hit/miss statistics of the cache.
+		 */
+		cache::CacheStats ParseCache::get_stats() const {
+			return entries.get_stats();
+		}
+
 	} // namespace pcb
 } // namespace gerbertools
 
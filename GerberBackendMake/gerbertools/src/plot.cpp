@@ -196,5 +196,16 @@ const coord::Paths &Plot::get_clear() const {
     return clear;
 }
 
+/**
+ * Commits and simplifies all paths drawn so far, such that get_dark() and
+ * get_clear() no longer modify the plot. Once finalized, a plot may be
+ * read from multiple threads concurrently, as long as nothing more is
+ * drawn to it.
+ */
+void Plot::finalize() {
+    commit_paths();
+    simplify();
+}
+
 } // namespace plot
 } // namespace gerbertools
@@ -0,0 +1,345 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Jeroen van Straten
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \file
+ * Contains the building blocks for the binary board snapshot format: a
+ * delta/varint encoder and decoder for geometry, and a section table that
+ * allows individual sections to be located without decoding the others.
+ */
+
+#include "snapshot.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace gerbertools {
+namespace snapshot {
+
+/**
+ * Magic number at the start of every snapshot ("GTBS" in little-endian).
+ */
+static const uint32_t MAGIC = 0x53425447;
+
+/**
+ * Size of the snapshot header.
+ */
+static const size_t HEADER_SIZE = 16;
+
+/**
+ * Size of a section table entry.
+ */
+static const size_t ENTRY_SIZE = 24;
+
+/**
+ * Rounds the given offset up to a multiple of 8.
+ */
+static size_t align8(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+/**
+ * Writes a little-endian integer of the given size at the given offset.
+ */
+static void write_le(std::string &data, size_t offset, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        data[offset + i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+/**
+ * Reads a little-endian integer of the given size at the given offset.
+ */
+static uint64_t read_le(std::string_view data, size_t offset, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = size; i > 0; i--) {
+        value = (value << 8) | static_cast<uint8_t>(data[offset + i - 1]);
+    }
+    return value;
+}
+
+/**
+ * Appends an unsigned varint.
+ */
+Encoder &Encoder::put_varint(uint64_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<char>(value));
+    return *this;
+}
+
+/**
+ * Appends a zigzag-encoded signed varint.
+ */
+Encoder &Encoder::put_svarint(int64_t value) {
+    return put_varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+/**
+ * Appends a double as 8 raw bytes.
+ */
+Encoder &Encoder::put_double(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto offset = data.size();
+    data.resize(offset + 8);
+    write_le(data, offset, bits, 8);
+    return *this;
+}
+
+/**
+ * Appends a string.
+ */
+Encoder &Encoder::put_string(const std::string &value) {
+    put_varint(value.size());
+    data.append(value);
+    return *this;
+}
+
+/**
+ * Appends a path, delta-encoded.
+ */
+Encoder &Encoder::put_path(const coord::Path &path) {
+    put_varint(path.size());
+    coord::CPt prev(0, 0);
+    for (const auto &pt : path) {
+        put_svarint(pt.X - prev.X);
+        put_svarint(pt.Y - prev.Y);
+        prev = pt;
+    }
+    return *this;
+}
+
+/**
+ * Appends a set of paths.
+ */
+Encoder &Encoder::put_paths(const coord::Paths &paths) {
+    put_varint(paths.size());
+    for (const auto &path : paths) {
+        put_path(path);
+    }
+    return *this;
+}
+
+/**
+ * Returns the encoded data.
+ */
+const std::string &Encoder::get_data() const {
+    return data;
+}
+
+/**
+ * Constructs a decoder for the given section data.
+ */
+Decoder::Decoder(std::string_view data) : data(data), pos(0) {
+}
+
+/**
+ * Reads an unsigned varint.
+ */
+uint64_t Decoder::get_varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= data.size()) {
+            throw std::runtime_error("truncated snapshot section");
+        }
+        auto byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("malformed varint in snapshot section");
+}
+
+/**
+ * Reads a zigzag-encoded signed varint.
+ */
+int64_t Decoder::get_svarint() {
+    auto value = get_varint();
+    return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+/**
+ * Reads a double.
+ */
+double Decoder::get_double() {
+    if (pos + 8 > data.size()) {
+        throw std::runtime_error("truncated snapshot section");
+    }
+    auto bits = read_le(data, pos, 8);
+    pos += 8;
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Reads a string.
+ */
+std::string Decoder::get_string() {
+    auto size = get_varint();
+    if (size > data.size() - pos) {
+        throw std::runtime_error("truncated snapshot section");
+    }
+    std::string value(data.substr(pos, size));
+    pos += size;
+    return value;
+}
+
+/**
+ * Reads a delta-encoded path.
+ */
+coord::Path Decoder::get_path() {
+    auto size = get_varint();
+    if (size > data.size() - pos) {
+        throw std::runtime_error("truncated snapshot section");
+    }
+    coord::Path path;
+    path.reserve(size);
+    coord::CPt pt(0, 0);
+    for (uint64_t i = 0; i < size; i++) {
+        pt.X += get_svarint();
+        pt.Y += get_svarint();
+        path.push_back(pt);
+    }
+    return path;
+}
+
+/**
+ * Reads a set of paths. Throws if any of them is empty.
+ */
+coord::Paths Decoder::get_paths() {
+    auto size = get_varint();
+    if (size > data.size() - pos) {
+        throw std::runtime_error("truncated snapshot section");
+    }
+    coord::Paths paths;
+    paths.reserve(size);
+    for (uint64_t i = 0; i < size; i++) {
+        paths.push_back(get_path());
+
+        // Polygons are never empty, and the renderers rely on that.
+        if (paths.back().empty()) {
+            throw std::runtime_error("empty path in snapshot section");
+        }
+    }
+    return paths;
+}
+
+/**
+ * Returns whether the whole section has been read.
+ */
+bool Decoder::at_end() const {
+    return pos >= data.size();
+}
+
+/**
+ * Adds a section with the given tag. Sections with the same tag keep the
+ * order in which they were added.
+ */
+void Writer::add(uint32_t tag, const Encoder &encoder) {
+    tags.push_back(tag);
+    sections.push_back(encoder.get_data());
+}
+
+/**
+ * Returns the complete snapshot.
+ */
+std::string Writer::finish() const {
+    auto offset = align8(HEADER_SIZE + ENTRY_SIZE * sections.size());
+    std::vector<size_t> offsets;
+    for (const auto &section : sections) {
+        offsets.push_back(offset);
+        offset = align8(offset + section.size());
+    }
+    std::string data(offset, '\0');
+    write_le(data, 0, MAGIC, 4);
+    write_le(data, 4, VERSION, 4);
+    write_le(data, 8, sections.size(), 4);
+    for (size_t i = 0; i < sections.size(); i++) {
+        auto entry = HEADER_SIZE + ENTRY_SIZE * i;
+        write_le(data, entry, tags[i], 4);
+        write_le(data, entry + 8, offsets[i], 8);
+        write_le(data, entry + 16, sections[i].size(), 8);
+        std::memcpy(&data[offsets[i]], sections[i].data(), sections[i].size());
+    }
+    return data;
+}
+
+/**
+ * Validates the header and section table of the given snapshot. Throws a
+ * std::runtime_error if the snapshot is malformed.
+ */
+Reader::Reader(std::string_view data) : data(data) {
+    if (data.size() < HEADER_SIZE || read_le(data, 0, 4) != MAGIC) {
+        throw std::runtime_error("not a board snapshot");
+    }
+    if (read_le(data, 4, 4) != VERSION) {
+        throw std::runtime_error("unsupported board snapshot version");
+    }
+    auto count = read_le(data, 8, 4);
+    if (count > (data.size() - HEADER_SIZE) / ENTRY_SIZE) {
+        throw std::runtime_error("truncated board snapshot");
+    }
+    for (size_t i = 0; i < count; i++) {
+        auto entry = HEADER_SIZE + ENTRY_SIZE * i;
+        Section section;
+        section.tag = static_cast<uint32_t>(read_le(data, entry, 4));
+        section.offset = read_le(data, entry + 8, 8);
+        section.size = read_le(data, entry + 16, 8);
+        if (section.offset > data.size() || section.size > data.size() - section.offset) {
+            throw std::runtime_error("truncated board snapshot");
+        }
+        table.push_back(section);
+    }
+}
+
+/**
+ * Returns the data of all sections with the given tag, in order.
+ */
+std::vector<std::string_view> Reader::find_all(uint32_t tag) const {
+    std::vector<std::string_view> result;
+    for (const auto &section : table) {
+        if (section.tag == tag) {
+            result.push_back(data.substr(section.offset, section.size));
+        }
+    }
+    return result;
+}
+
+/**
+ * Returns the data of the only section with the given tag. Throws a
+ * std::runtime_error if there is not exactly one such section.
+ */
+std::string_view Reader::find(uint32_t tag) const {
+    auto sections = find_all(tag);
+    if (sections.size() != 1) {
+        throw std::runtime_error("board snapshot is missing a section");
+    }
+    return sections.front();
+}
+
+} // namespace snapshot
+} // namespace gerbertools
@@ -2,6 +2,9 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <mutex>
+#include "cache.hpp"
+#include "hash.hpp"
 #include "obj.hpp"
 #include "path.hpp"
 #include "pcb.hpp"
@@ -35,8 +38,41 @@ typedef struct {
 extern "C" {
 	__declspec(dllexport) void processPCBFiles(KeyValue* data, size_t data_size, char*& frontSvg, char*& backSvg);
 	__declspec(dllexport) void generateMTLAndOBJFiles(KeyValue* data, size_t data_size, char*& mtl, char*& obj);
+	// Builds the board once and produces the outputs selected by the
+	// pcb::OutputFlags in outputs; outputs that were not requested are NULL.
+	__declspec(dllexport) void renderPCBFiles(KeyValue* data, size_t data_size, unsigned outputs, char*& frontSvg, char*& backSvg, char*& mtl, char*& obj);
+	// Returns the content hash of the files and outputs as 16 hex digits, for
+	// use as an ETag. Identical to the key renderPCBFiles caches under.
+	__declspec(dllexport) void getPCBETag(KeyValue* data, size_t data_size, unsigned outputs, char*& etag);
+	__declspec(dllexport) void setPCBCacheBudget(size_t board_budget, size_t output_budget, size_t parse_budget);
+	__declspec(dllexport) void getPCBCacheStats(cache::CacheStats& boards, cache::CacheStats& outputs, cache::CacheStats& parses);
+	__declspec(dllexport) void clearPCBCache();
+	// Builds the board and returns it as a binary snapshot, which may contain
+	// NUL bytes; its size is returned separately. Free with free(). On
+	// allocation failure, snapshot is null and snapshot_size is 0.
+	__declspec(dllexport) void snapshotPCBFiles(KeyValue* data, size_t data_size, char*& snapshot, size_t& snapshot_size);
+	// Produces outputs from a snapshot, without reparsing any Gerber files.
+	__declspec(dllexport) void renderPCBSnapshot(const char* snapshot, size_t snapshot_size, unsigned outputs, char*& frontSvg, char*& backSvg, char*& mtl, char*& obj);
 }
 
+static const double SVG_SCALE = 2.0;
+
+// Built boards, keyed by the hash of their input files. Boards are kept in
+// packed form and only expanded when a request needs them.
+static cache::LruCache<uint64_t, std::shared_ptr<const pcb::PackedBoard>> board_cache(256u << 20);
+
+// Rendered outputs, keyed by the hash of the input files and render parameters.
+static cache::LruCache<uint64_t, std::shared_ptr<const pcb::RenderedOutputs>> output_cache(256u << 20);
+
+// Parsed layer and drill files, keyed by the hash of each file, so that a
+// re-upload with one changed layer only reparses that layer.
+static pcb::ParseCache parse_cache(256u << 20);
+
+// Frozen boards that are currently in use, so that concurrent requests for the
+// same files render from one shared board instead of each expanding their own.
+static std::mutex live_boards_mutex;
+static std::map<uint64_t, std::weak_ptr<const pcb::CircuitBoard>> live_boards;
+
 static void FreeKeyValue(KeyValue* kv) {
 	if (kv) {
 		if (kv->key) {
@@ -59,85 +95,140 @@ static void FreeKeyValue(KeyValue* kv) {
 	}
 }
 
-extern "C" {
-
-	__declspec(dllexport)  void processPCBFiles(KeyValue* data, size_t data_size, char*& frontSvg, char*& backSvg) {
-		std::map<std::string, std::vector<std::string>> files;
+// The file contents are viewed in place, not copied; they are owned by the
+// caller for the duration of the call.
+static pcb::FileViews ToFileMap(KeyValue* data, size_t data_size) {
+	pcb::FileViews files;
 
-		for (size_t i = 0; i < data_size; ++i) {
-			KeyValue kv = data[i];
-			std::string key(kv.key);
-
-			std::vector<std::string> values;
-			for (size_t j = 0; j < kv.value_count; ++j) {
-				values.push_back(kv.values[j]);
-			}
+	for (size_t i = 0; i < data_size; ++i) {
+		KeyValue kv = data[i];
+		std::string key(kv.key);
 
-			files[key] = values;
+		std::vector<std::string_view> values;
+		for (size_t j = 0; j < kv.value_count; ++j) {
+			values.push_back(kv.values[j]);
 		}
 
-		std::ostringstream strm_front;
-		std::ostringstream strm_back;
+		files[key] = values;
+	}
 
-		auto pcb = pcb::CircuitBoard::LoadPCB(files);
+	return files;
+}
 
-		pcb.write_svg(strm_front, false, 2.0);
-		pcb.write_svg(strm_back, true, 2.0);
+static uint64_t OutputKey(uint64_t files_hash, unsigned outputs) {
+	return gerbertools::hash::Hasher(files_hash).add(static_cast<uint64_t>(outputs)).add(SVG_SCALE).digest();
+}
 
-		std::string front_str = strm_front.str();
-		std::string back_str = strm_back.str();
+static std::shared_ptr<const pcb::CircuitBoard> FindLivePCB(uint64_t files_hash) {
+	std::lock_guard<std::mutex> lock(live_boards_mutex);
+	auto it = live_boards.find(files_hash);
+	return it == live_boards.end() ? nullptr : it->second.lock();
+}
 
-		frontSvg = _strdup(front_str.c_str());
-		backSvg = _strdup(back_str.c_str());
+static void AddLivePCB(uint64_t files_hash, const std::shared_ptr<const pcb::CircuitBoard>& pcb) {
+	std::lock_guard<std::mutex> lock(live_boards_mutex);
+	for (auto it = live_boards.begin(); it != live_boards.end(); ) {
+		it = it->second.expired() ? live_boards.erase(it) : std::next(it);
+	}
+	live_boards[files_hash] = pcb;
+}
 
-		front_str.clear();
-		back_str.clear();
-		files.clear();
-		strm_front.clear();
-		strm_back.clear();
+static std::shared_ptr<const pcb::CircuitBoard> LoadCachedPCB(const pcb::FileViews& files, uint64_t files_hash) {
+	if (auto pcb = FindLivePCB(files_hash)) {
+		return pcb;
+	}
+	std::shared_ptr<const pcb::CircuitBoard> pcb;
+	if (auto cached = board_cache.get(files_hash)) {
+		pcb = (*cached)->expand().freeze();
+	} else {
+		pcb = pcb::CircuitBoard::LoadPCB(files, 0, &parse_cache).freeze();
+		auto packed = std::make_shared<const pcb::PackedBoard>(pcb->pack());
+		board_cache.put(files_hash, packed, packed->get_memory_usage());
 	}
+	AddLivePCB(files_hash, pcb);
+	return pcb;
+}
 
-	__declspec(dllexport)  void generateMTLAndOBJFiles(KeyValue* data, size_t data_size, char*& mtl, char*& obj) {
-		std::map<std::string, std::vector<std::string>> files;
+extern "C" {
 
-		for (size_t i = 0; i < data_size; ++i) {
-			KeyValue kv = data[i];
-			std::string key(kv.key);
+	__declspec(dllexport)  void processPCBFiles(KeyValue* data, size_t data_size, char*& frontSvg, char*& backSvg) {
+		char* mtl = NULL;
+		char* obj = NULL;
+		renderPCBFiles(data, data_size, pcb::OUTPUT_FRONT_SVG | pcb::OUTPUT_BACK_SVG, frontSvg, backSvg, mtl, obj);
+	}
 
-			std::vector<std::string> values;
-			for (size_t j = 0; j < kv.value_count; ++j) {
-				values.push_back(kv.values[j]);
-			}
+	__declspec(dllexport)  void generateMTLAndOBJFiles(KeyValue* data, size_t data_size, char*& mtl, char*& obj) {
+		char* frontSvg = NULL;
+		char* backSvg = NULL;
+		renderPCBFiles(data, data_size, pcb::OUTPUT_MTL | pcb::OUTPUT_OBJ, frontSvg, backSvg, mtl, obj);
+	}
 
-			files[key] = values;
+	__declspec(dllexport)  void renderPCBFiles(KeyValue* data, size_t data_size, unsigned outputs, char*& frontSvg, char*& backSvg, char*& mtl, char*& obj) {
+		auto files = ToFileMap(data, data_size);
+		auto files_hash = gerbertools::hash::hash_files(files);
+		auto key = OutputKey(files_hash, outputs);
+
+		std::shared_ptr<const pcb::RenderedOutputs> result;
+		if (auto cached = output_cache.get(key)) {
+			result = *cached;
+		} else {
+			auto pcb = LoadCachedPCB(files, files_hash);
+			result = std::make_shared<const pcb::RenderedOutputs>(pcb->render(outputs, SVG_SCALE));
+			auto size = result->front_svg.size() + result->back_svg.size() + result->mtl.size() + result->obj.size();
+			output_cache.put(key, result, size);
 		}
 
-		std::ostringstream strm_mtl;
-		std::ostringstream strm_obj;
-
-		auto pcb = pcb::CircuitBoard::LoadPCB(files);
-
-		pcb.generate_mtl_file(strm_mtl);
-		pcb.write_obj(strm_obj);
-
-		std::string mtl_str = strm_mtl.str();
-		std::string obj_str = strm_obj.str();
-
-		mtl = _strdup(mtl_str.c_str());
-		obj = _strdup(obj_str.c_str());
-
-		strm_mtl.clear();
-		strm_obj.clear();
-		mtl_str.clear();
-		obj_str.clear();
-		files.clear();
+		frontSvg = (outputs & pcb::OUTPUT_FRONT_SVG) ? _strdup(result->front_svg.c_str()) : NULL;
+		backSvg = (outputs & pcb::OUTPUT_BACK_SVG) ? _strdup(result->back_svg.c_str()) : NULL;
+		mtl = (outputs & pcb::OUTPUT_MTL) ? _strdup(result->mtl.c_str()) : NULL;
+		obj = (outputs & pcb::OUTPUT_OBJ) ? _strdup(result->obj.c_str()) : NULL;
 	}
-}
 
+	__declspec(dllexport)  void getPCBETag(KeyValue* data, size_t data_size, unsigned outputs, char*& etag) {
+		auto files = ToFileMap(data, data_size);
+		auto key = OutputKey(gerbertools::hash::hash_files(files), outputs);
+		etag = _strdup(gerbertools::hash::to_hex(key).c_str());
+	}
 
+	__declspec(dllexport)  void setPCBCacheBudget(size_t board_budget, size_t output_budget, size_t parse_budget) {
+		board_cache.set_budget(board_budget);
+		output_cache.set_budget(output_budget);
+		parse_cache.set_budget(parse_budget);
+	}
 
+	__declspec(dllexport)  void getPCBCacheStats(cache::CacheStats& boards, cache::CacheStats& outputs, cache::CacheStats& parses) {
+		boards = board_cache.get_stats();
+		outputs = output_cache.get_stats();
+		parses = parse_cache.get_stats();
+	}
 
+	__declspec(dllexport)  void snapshotPCBFiles(KeyValue* data, size_t data_size, char*& snapshot, size_t& snapshot_size) {
+		auto files = ToFileMap(data, data_size);
+		auto pcb = LoadCachedPCB(files, gerbertools::hash::hash_files(files));
+		auto snapshot_str = pcb->write_snapshot();
 
+		snapshot = static_cast<char*>(malloc(snapshot_str.size()));
+		if (!snapshot) {
+			snapshot_size = 0;
+			return;
+		}
+		memcpy(snapshot, snapshot_str.data(), snapshot_str.size());
+		snapshot_size = snapshot_str.size();
+	}
 
+	__declspec(dllexport)  void renderPCBSnapshot(const char* snapshot, size_t snapshot_size, unsigned outputs, char*& frontSvg, char*& backSvg, char*& mtl, char*& obj) {
+		auto pcb = pcb::CircuitBoard::read_snapshot(std::string_view(snapshot, snapshot_size));
+		auto result = pcb.render(outputs, SVG_SCALE);
 
+		frontSvg = (outputs & pcb::OUTPUT_FRONT_SVG) ? _strdup(result.front_svg.c_str()) : NULL;
+		backSvg = (outputs & pcb::OUTPUT_BACK_SVG) ? _strdup(result.back_svg.c_str()) : NULL;
+		mtl = (outputs & pcb::OUTPUT_MTL) ? _strdup(result.mtl.c_str()) : NULL;
+		obj = (outputs & pcb::OUTPUT_OBJ) ? _strdup(result.obj.c_str()) : NULL;
+	}
 
+	__declspec(dllexport)  void clearPCBCache() {
+		board_cache.clear();
+		output_cache.clear();
+		parse_cache.clear();
+	}
+}